@@ -0,0 +1,93 @@
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+
+#include "alloccount.h"
+
+namespace {
+  thread_local uint64_t allocations = 0;
+  thread_local int64_t live = 0;
+
+  void *countedAlloc(std::size_t size) {
+    allocations++;
+    if (size == 0) size = 1;
+    void *p = std::malloc(size);
+    if (p) live += malloc_usable_size(p);
+    return p;
+  }
+
+  void countedFree(void *p) {
+    if (p) live -= malloc_usable_size(p);
+    std::free(p);
+  }
+}
+
+uint64_t AllocCounter::count() {
+  return allocations;
+}
+
+int64_t AllocCounter::liveBytes() {
+  return live;
+}
+
+void AllocStats::addTurn(const uint64_t allocations) {
+  turns++;
+  turnAllocations += allocations;
+  if (allocations > maxTurnAllocations) maxTurnAllocations = allocations;
+}
+
+void AllocStats::addRound(const uint64_t allocations) {
+  rounds++;
+  roundAllocations += allocations;
+}
+
+void AllocStats::addGame(const uint64_t allocations) {
+  games++;
+  gameAllocations += allocations;
+}
+
+void AllocStats::print(std::ostream &out) const {
+  auto perItem = [](uint64_t total, uint64_t items) {
+    return items > 0 ? static_cast<double>(total) / items : 0.0;
+  };
+  out << "allocations/turn: " << perItem(turnAllocations, turns)
+      << " (max " << maxTurnAllocations << ")" << std::endl;
+  out << "allocations/round: " << perItem(roundAllocations, rounds) << std::endl;
+  out << "allocations/game: " << perItem(gameAllocations, games) << std::endl;
+}
+
+void *operator new(std::size_t size) {
+  void *p = countedAlloc(size);
+  if (!p) throw std::bad_alloc{};
+  return p;
+}
+
+void *operator new[](std::size_t size) {
+  void *p = countedAlloc(size);
+  if (!p) throw std::bad_alloc{};
+  return p;
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return countedAlloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept {
+  countedFree(p);
+}
+
+void operator delete[](void *p) noexcept {
+  countedFree(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  countedFree(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  countedFree(p);
+}
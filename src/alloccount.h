@@ -0,0 +1,45 @@
+#ifndef _H_ALLOCCOUNT
+#define _H_ALLOCCOUNT
+
+/*
+Counts heap allocations, and the bytes still held, by replacing the
+global operator new and delete. Only programs that link alloccount.o are
+counted; the counts are kept per thread, so they are cheap and never
+contended.
+
+AllocStats totals the counts over the turns, rounds and games of headless
+runs, so allocations on the turn loop can be reported and gated on.
+*/
+
+#include <cstdint>
+#include <iostream>
+
+class AllocCounter {
+  // Is a static class
+  AllocCounter() {};
+public:
+  // Number of allocations made by the calling thread so far
+  static uint64_t count();
+  // Heap bytes allocated by the calling thread and not yet freed. Memory
+  // freed by another thread is taken off that thread's count instead.
+  static int64_t liveBytes();
+};
+
+// Allocations made during computer turns, rounds and games
+struct AllocStats {
+  uint64_t turns = 0;
+  uint64_t turnAllocations = 0;
+  // Most allocations made in any one turn
+  uint64_t maxTurnAllocations = 0;
+  uint64_t rounds = 0;
+  uint64_t roundAllocations = 0;
+  uint64_t games = 0;
+  uint64_t gameAllocations = 0;
+  void addTurn(uint64_t allocations);
+  void addRound(uint64_t allocations);
+  void addGame(uint64_t allocations);
+  // Prints the average allocations per turn, round and game
+  void print(std::ostream &out) const;
+};
+
+#endif
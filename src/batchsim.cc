@@ -0,0 +1,184 @@
+#include <cstring>
+
+#include "batchsim.h"
+#include "model.h"
+
+namespace {
+  // Lanes of 64-bit masks, operated on with vector instructions. Two
+  // fill the SSE2 registers every x86-64 processor has.
+  typedef uint64_t Lanes __attribute__((vector_size(16)));
+  const size_t LANE_WIDTH = sizeof(Lanes) / sizeof(uint64_t);
+
+  // The arrays aren't aligned for the vector type, so go through memcpy
+  inline Lanes loadLanes(const uint64_t *from) {
+    Lanes v;
+    std::memcpy(&v, from, sizeof(v));
+    return v;
+  }
+
+  inline void storeLanes(uint64_t *to, const Lanes v) {
+    std::memcpy(to, &v, sizeof(v));
+  }
+
+  const uint64_t SEAT_CARDS = (uint64_t{1} << RANKS_PER_SUIT) - 1;
+}
+
+BatchSimulator::BatchSimulator(const ShuffleMode shuffle, const size_t lanes) :
+  shuffle{shuffle},
+  // Rounded up, so the vector loop never runs past the end
+  lanes{(lanes + LANE_WIDTH - 1) / LANE_WIDTH * LANE_WIDTH},
+  games(this->lanes), held(this->lanes, 0), playable(this->lanes, 0),
+  moves(this->lanes, 0), startSeat(this->lanes, 0),
+  unlocks(this->lanes * NUM_CARDS, 0), points(this->lanes * NUM_CARDS, 0),
+  penalties(this->lanes * NUM_SEATS, 0)
+{}
+
+void BatchSimulator::startGame(const size_t lane, const size_t game,
+                               const unsigned seed) {
+  LaneGame &g = games[lane];
+  // Shuffles exactly as a Deck with this seed would. Engines are reused
+  // from the lane's last game.
+  if (g.shuffler) g.shuffler->reseed(seed);
+  else g.shuffler = makeShuffleEngine(shuffle, seed);
+  for (int i = 0; i < NUM_CARDS; i++) g.order[i] = i;
+  g.game = game;
+  for (int &total : g.totals) total = 0;
+  g.rounds = 0;
+  g.over = false;
+}
+
+void BatchSimulator::deal(const size_t lane) {
+  LaneGame &g = games[lane];
+  g.shuffler->shuffle(g.order);
+  const int sevenOfSpades = cardIndex(SPADES, SEVEN);
+  int start = 0;
+  while (g.order[start] != sevenOfSpades) start++;
+  start /= RANKS_PER_SUIT;
+  startSeat[lane] = start;
+
+  uint8_t cardAt[NUM_CARDS];
+  uint8_t positionOf[NUM_CARDS];
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    const int dealtTo = (start + seat) % NUM_SEATS;
+    for (int i = 0; i < RANKS_PER_SUIT; i++) {
+      const int position = seat * RANKS_PER_SUIT + i;
+      const int card = g.order[dealtTo * RANKS_PER_SUIT + i];
+      cardAt[position] = card;
+      positionOf[card] = position;
+    }
+    penalties[seat * lanes + lane] = 0;
+  }
+  uint64_t *laneUnlocks = &unlocks[lane * NUM_CARDS];
+  uint8_t *lanePoints = &points[lane * NUM_CARDS];
+  for (int position = 0; position < NUM_CARDS; position++) {
+    const int card = cardAt[position];
+    const int rank = rankOfIndex(card);
+    // Piles grow outwards from their sevens, so a card unlocks the one
+    // past it (both neighbours, for a seven)
+    uint64_t unlocked = 0;
+    if (rank <= STARTING_RANK && rank > 1) {
+      unlocked |= uint64_t{1} << positionOf[card - 1];
+    }
+    if (rank >= STARTING_RANK && rank < RANKS_PER_SUIT) {
+      unlocked |= uint64_t{1} << positionOf[card + 1];
+    }
+    laneUnlocks[position] = unlocked;
+    lanePoints[position] = rank;
+  }
+  uint64_t sevens = 0;
+  for (int suit = 1; suit <= NUM_SUITS; suit++) {
+    sevens |= uint64_t{1} << positionOf[cardIndex(suit, STARTING_RANK)];
+  }
+  held[lane] = ALL_CARDS;
+  playable[lane] = sevens;
+}
+
+void BatchSimulator::playTurn(const int seat) {
+  const uint64_t seatCards = SEAT_CARDS << (seat * RANKS_PER_SUIT);
+  const Lanes seatMask = Lanes{} + seatCards;
+  int *seatPenalties = &penalties[seat * lanes];
+  for (size_t first = 0; first < active; first += LANE_WIDTH) {
+    const Lanes hand = loadLanes(&held[first]) & seatMask;
+    const Lanes legal = hand & loadLanes(&playable[first]);
+    // All ones in the lanes with something to play
+    const Lanes canPlay = reinterpret_cast<Lanes>(legal != Lanes{});
+    // The first legal card in hand order, or else the first card
+    const Lanes choices = (legal & canPlay) | (hand & ~canPlay);
+    const Lanes move = choices & -choices;
+    storeLanes(&held[first], loadLanes(&held[first]) ^ move);
+    storeLanes(&moves[first], move);
+    // Lanes past active hold no cards, so they never move
+    for (size_t lane = first; lane < first + LANE_WIDTH; lane++) {
+      const uint64_t bit = moves[lane];
+      if (!bit) continue;
+      const int position = __builtin_ctzll(bit);
+      if (playable[lane] & bit) {
+        playable[lane] = (playable[lane] ^ bit) |
+                         unlocks[lane * NUM_CARDS + position];
+      } else {
+        seatPenalties[lane] += points[lane * NUM_CARDS + position];
+      }
+    }
+  }
+}
+
+bool BatchSimulator::finishRound(const size_t lane) {
+  LaneGame &g = games[lane];
+  g.rounds++;
+  bool over = false;
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    int &total = g.totals[(startSeat[lane] + seat) % NUM_SEATS];
+    total += penalties[seat * lanes + lane];
+    over = over || total >= StraightsModel::MAX_SCORE;
+  }
+  return over;
+}
+
+void BatchSimulator::compact() {
+  size_t lane = 0;
+  while (lane < active) {
+    if (!games[lane].over) {
+      lane++;
+      continue;
+    }
+    active--;
+    std::swap(games[lane], games[active]);
+    held[active] = 0;
+  }
+}
+
+std::vector<GameResult> BatchSimulator::play(const std::vector<unsigned> &seeds) {
+  std::vector<GameResult> results(seeds.size());
+  size_t next = 0;
+  for (active = 0; active < lanes && next < seeds.size(); active++, next++) {
+    startGame(active, next, seeds[next]);
+  }
+  for (size_t lane = active; lane < lanes; lane++) held[lane] = 0;
+  while (active > 0) {
+    for (size_t lane = 0; lane < active; lane++) deal(lane);
+    for (int turn = 0; turn < NUM_CARDS; turn++) playTurn(turn % NUM_SEATS);
+    for (size_t lane = 0; lane < active; lane++) {
+      if (!finishRound(lane)) continue;
+      LaneGame &g = games[lane];
+      // Picks the winners the way StraightsModel::getWinners does
+      int lowest = StraightsModel::MAX_SCORE;
+      for (const int total : g.totals) {
+        if (total < lowest) lowest = total;
+      }
+      GameResult &result = results[g.game];
+      result.rounds = g.rounds;
+      for (const int total : g.totals) {
+        result.scores.push_back(total);
+        result.won.push_back(total == lowest);
+      }
+      if (next < seeds.size()) {
+        startGame(lane, next, seeds[next]);
+        next++;
+      } else {
+        g.over = true;
+      }
+    }
+    compact();
+  }
+  return results;
+}
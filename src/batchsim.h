@@ -0,0 +1,86 @@
+#ifndef _H_BATCHSIM
+#define _H_BATCHSIM
+
+/*
+A structure-of-arrays engine that plays many games of four simple players
+(cccc) at once, in lockstep, for runs that need huge numbers of games.
+
+Each lane of the batch is one game, and every per-game value (hands,
+playable cards, penalties) is kept in its own contiguous array indexed by
+lane. Two relabellings let every lane take the same step on every turn:
+
+- Cards are numbered by their position in the deal instead of by suit and
+  rank, so bit i of a lane's hand mask is the i'th card dealt. A seat's
+  hand is then in the order SimpleStrategy looks through it, and its
+  first legal card is simply the lowest set bit of hand & playable.
+- Seats are numbered from the one holding the seven of spades, so on turn
+  t it's seat t % 4's move in every lane.
+
+A turn is then the same few mask operations for every lane, computed with
+vector instructions several lanes at a time, followed by a table lookup
+per lane to find which cards the move made playable. Rounds always last
+52 turns, so lanes never fall out of step. When a game ends, its lane
+starts the next one.
+
+Deals come from the same shuffle engines as Deck, so each game has exactly
+the result playCoreGame and playHeadlessGame give for its seed.
+*/
+
+#include <memory>
+#include <vector>
+
+#include "deck.h"
+#include "simstate.h"
+#include "simulation.h"
+
+class BatchSimulator {
+  // A game in a lane, kept from one round to the next
+  struct LaneGame {
+    std::unique_ptr<ShuffleEngine> shuffler;
+    DeckOrder order;
+    // Index of the game in the seeds passed to play()
+    size_t game = 0;
+    int totals[NUM_SEATS] = {0, 0, 0, 0};
+    unsigned rounds = 0;
+    bool over = false;
+  };
+
+  const ShuffleMode shuffle;
+  const size_t lanes;
+  // Lanes from 0 up to active hold games
+  size_t active = 0;
+  std::vector<LaneGame> games;
+  // Indexed by lane. Masks are in deal positions, relative to the
+  // starting seat: seat s holds positions 13 * s to 13 * s + 12.
+  std::vector<uint64_t> held;
+  std::vector<uint64_t> playable;
+  std::vector<uint64_t> moves;
+  std::vector<uint8_t> startSeat;
+  // Indexed by lane * NUM_CARDS + position: the cards that become
+  // playable once the card at the position is played, and its points
+  std::vector<uint64_t> unlocks;
+  std::vector<uint8_t> points;
+  // Indexed by seat * lanes + lane, where seat is relative to the start
+  std::vector<int> penalties;
+
+  void startGame(size_t lane, size_t game, unsigned seed);
+  void deal(size_t lane);
+  // Plays one turn of the given (relative) seat in every lane
+  void playTurn(int seat);
+  // Adds up a finished round, returning true if the game is over
+  bool finishRound(size_t lane);
+  // Moves the games still playing to the front lanes
+  void compact();
+
+public:
+  static const size_t DEFAULT_LANES = 1024;
+  // Games worth passing to play() at once, to keep the lanes busy
+  static const size_t BATCH_GAMES = 16 * DEFAULT_LANES;
+
+  explicit BatchSimulator(ShuffleMode shuffle = ShuffleMode::LEGACY,
+                          size_t lanes = DEFAULT_LANES);
+  // Plays a game for each seed, and returns the results in the same order
+  std::vector<GameResult> play(const std::vector<unsigned> &seeds);
+};
+
+#endif
@@ -0,0 +1,443 @@
+/*
+Microbenchmarks for the engine's hot paths. Built and run with `make bench`.
+
+Each benchmark prints one JSON object per line, with the time and number
+of heap allocations per operation, so runs can be compared between
+releases. An optional argument gives the minimum seconds spent on each
+benchmark.
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+#include "model.h"
+#include "view.h"
+#include "controller.h"
+#include "deck.h"
+#include "player.h"
+#include "simulation.h"
+#include "alloccount.h"
+#include "endgame.h"
+#include "simcore.h"
+#include "batchsim.h"
+#include "heuristic.h"
+#include "inference.h"
+#include "scan.h"
+#include "perft.h"
+
+using namespace std;
+
+namespace {
+  double minSeconds = 0.25;
+  const unsigned seed = 1;
+  // Written to so the compiler can't drop the benchmarked calls
+  volatile uint64_t sink = 0;
+
+  struct BenchResult {
+    uint64_t iterations = 0;
+    double seconds = 0;
+    uint64_t allocations = 0;
+  };
+
+  // Calls body until at least minSeconds have passed
+  template <typename F>
+  BenchResult measure(F body) {
+    BenchResult r;
+    uint64_t batch = 1;
+    const uint64_t allocsBefore = AllocCounter::count();
+    const auto start = chrono::steady_clock::now();
+    while (r.seconds < minSeconds) {
+      for (uint64_t i = 0; i < batch; i++) {
+        body();
+      }
+      r.iterations += batch;
+      batch *= 2;
+      const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+      r.seconds = elapsed.count();
+    }
+    r.allocations = AllocCounter::count() - allocsBefore;
+    return r;
+  }
+
+  void report(const string &name, const BenchResult &r, double opsPerCall,
+              const string &extra = "") {
+    const double ops = r.iterations * opsPerCall;
+    cout << "{\"bench\":\"" << name << "\""
+         << ",\"iterations\":" << r.iterations
+         << ",\"ns_per_op\":" << r.seconds * 1e9 / ops
+         << ",\"allocs_per_op\":" << r.allocations / ops
+         << extra << "}" << endl;
+  }
+
+  template <typename F>
+  void bench(const string &name, double opsPerCall, F body) {
+    report(name, measure(body), opsPerCall);
+  }
+
+  const vector<string> CARD_NAMES = {
+    "AC", "2C", "3C", "4C", "5C", "6C", "7C", "8C", "9C", "10C", "JC", "QC", "KC",
+    "AD", "2D", "3D", "4D", "5D", "6D", "7D", "8D", "9D", "10D", "JD", "QD", "KD",
+    "AH", "2H", "3H", "4H", "5H", "6H", "7H", "8H", "9H", "10H", "JH", "QH", "KH",
+    "AS", "2S", "3S", "4S", "5S", "6S", "7S", "8S", "9S", "10S", "JS", "QS", "KS"
+  };
+
+  // A move made by SimpleStrategy, to be replayed
+  struct Move {
+    Player *player;
+    Card *card;
+    bool discard;
+  };
+
+  // Plays out the dealt round the way SimpleStrategy would, and returns
+  // the moves made
+  vector<Move> simpleRound(StraightsModel &model, const vector<Player *> &seats) {
+    vector<Move> moves;
+    unsigned seat = 0;
+    while (seats[seat] != model.whoHasCard(*model.getCard("7S"))) seat++;
+    while (!model.isEndOfRound()) {
+      Player &p = *seats[seat];
+      const vector<Card *> legalPlays = model.getLegalPlays(p);
+      if (!legalPlays.empty()) {
+        moves.push_back(Move{&p, legalPlays[0], false});
+        model.playCard(p, *legalPlays[0]);
+      } else {
+        moves.push_back(Move{&p, p.getHand()[0], true});
+        model.discardCard(p, *p.getHand()[0]);
+      }
+      seat = (seat + 1) % seats.size();
+    }
+    return moves;
+  }
+}
+
+int main(int argc, char *argv[]) {
+  if (argc == 2) minSeconds = stod(argv[1]);
+
+  const vector<pair<string, ShuffleMode>> shuffleModes = {
+    {"legacy", ShuffleMode::LEGACY}, {"xoshiro", ShuffleMode::XOSHIRO},
+    {"pcg", ShuffleMode::PCG}, {"counter", ShuffleMode::COUNTER}
+  };
+  for (const auto &mode : shuffleModes) {
+    Deck deck{seed, mode.second};
+    bench("deck_shuffle_" + mode.first, 1, [&deck]() { deck.shuffle(); });
+  }
+
+  {
+    // The first legacy shuffle of consecutive seeds, as --scan deals them
+    const LegacyDealer dealer;
+    const DealPredicate predicate{"next stuck"};
+    unsigned seeds[LegacyDealer::LANES];
+    DeckOrder orders[LegacyDealer::LANES];
+    unsigned next = seed;
+    bench("scan_legacy_deal", LegacyDealer::LANES, [&]() {
+      for (unsigned &s : seeds) {
+        s = next++;
+      }
+      dealer.deal(seeds, orders);
+      for (const DeckOrder &order : orders) {
+        sink += predicate.matches(order);
+      }
+    });
+  }
+
+  bench("card_parse", CARD_NAMES.size(), []() {
+    for (const string &name : CARD_NAMES) {
+      sink += parseCardId(name.data(), name.size()).value;
+    }
+  });
+  bench("card_format", NUM_CARDS, []() {
+    char name[CARD_NAME_SIZE];
+    for (int index = 0; index < NUM_CARDS; index++) {
+      sink += formatCardId(CardId{index}, name);
+    }
+  });
+  bench("model_construct", 1, []() {
+    StraightsModel model{seed};
+    sink += model.getCard(0)->getIndex();
+  });
+
+  {
+    Deck deck{seed};
+    HumanPlayer receiver{"Bench"};
+    bench("deck_deal_card", NUM_CARDS, [&deck, &receiver]() {
+      deck.reset();
+      receiver.reset();
+      for (int i = 0; i < NUM_CARDS; i++) {
+        deck.dealCard(receiver);
+      }
+    });
+  }
+
+  {
+    StraightsModel model{seed};
+    NullView view;
+    StraightsController controller{view, model};
+    controller.initializePlayers("cccc");
+    vector<Player *> seats;
+    model.forEachPlayer([&seats](Player &p) { seats.push_back(&p); });
+    vector<Card *> cards;
+    for (const string &name : CARD_NAMES) {
+      cards.push_back(model.getCard(name));
+    }
+    model.shuffleDeck();
+    model.dealHands();
+
+    // Removing each card of a hand, less the cost of refilling it
+    HumanPlayer holder{"Bench"};
+    const vector<Card *> hand = seats[0]->getHand();
+    const BenchResult refill = measure([&holder, &hand]() {
+      holder.reset();
+      for (Card *card : hand) holder.giveCard(*card);
+    });
+    const BenchResult refillAndRemove = measure([&holder, &hand]() {
+      holder.reset();
+      for (Card *card : hand) holder.giveCard(*card);
+      for (Card *card : hand) holder.removeCard(*card);
+    });
+    BenchResult removeCard = refillAndRemove;
+    removeCard.seconds -=
+      refill.seconds / refill.iterations * refillAndRemove.iterations;
+    removeCard.allocations -=
+      refill.allocations * refillAndRemove.iterations / refill.iterations;
+    report("player_remove_card", removeCard, hand.size());
+
+    // Replaying a whole round of plays, less the cost of dealing it
+    const vector<Move> moves = simpleRound(model, seats);
+    const BenchResult deal = measure([&model]() {
+      model.resetRound();
+      model.dealHands();
+    });
+    report("model_reset_and_deal", deal, 1);
+    const BenchResult replay = measure([&model, &moves]() {
+      model.resetRound();
+      model.dealHands();
+      for (const Move &m : moves) {
+        if (m.discard) model.discardCard(*m.player, *m.card);
+        else model.playCard(*m.player, *m.card);
+      }
+    });
+    BenchResult playCard = replay;
+    playCard.seconds -= deal.seconds / deal.iterations * replay.iterations;
+    playCard.allocations -= deal.allocations * replay.iterations / deal.iterations;
+    report("model_play_card", playCard, moves.size());
+
+    // Queries on a board part way through the round
+    model.resetRound();
+    model.dealHands();
+    for (unsigned i = 0; i < moves.size() / 2; i++) {
+      const Move &m = moves[i];
+      if (m.discard) model.discardCard(*m.player, *m.card);
+      else model.playCard(*m.player, *m.card);
+    }
+    bench("model_get_legal_plays", seats.size(), [&model, &seats]() {
+      for (Player *p : seats) sink += model.getLegalPlays(*p).size();
+    });
+    bench("model_is_legal_play", cards.size(), [&model, &cards]() {
+      for (Card *card : cards) sink += model.isLegalPlay(*card);
+    });
+    bench("model_get_legal_play_mask", seats.size(), [&model, &seats]() {
+      for (Player *p : seats) sink += model.getLegalPlayMask(*p);
+    });
+    bench("model_hash", 1, [&model]() { sink += model.hash(); });
+    bench("model_compute_hash", 1, [&model]() { sink += model.computeHash(); });
+    bench("model_who_has_card", cards.size(), [&model, &cards]() {
+      for (Card *card : cards) sink += model.whoHasCard(*card) != nullptr;
+    });
+
+    // Making the rest of the round's moves, then taking them all back
+    const ModelSnapshot midRound = model.snapshot();
+    const unsigned remaining = moves.size() - moves.size() / 2;
+    bench("model_make_unmake", remaining * 2, [&model, &moves, midRound]() {
+      for (unsigned i = moves.size() / 2; i < moves.size(); i++) {
+        const Move &m = moves[i];
+        const int index = m.card->getIndex();
+        model.makeMove(*m.player, m.discard ? discardMove(index) : playMove(index));
+      }
+      model.restore(midRound);
+    });
+
+    // Full rounds, including the shuffle
+    model.resetRound();
+    bench("simple_strategy_round", 1, [&model, &controller]() {
+      controller.playRound();
+      model.resetRound();
+    });
+  }
+
+  {
+    unsigned gameSeed = seed;
+    const BenchResult games = measure([&gameSeed]() {
+      sink += playHeadlessGame("cccc", gameSeed++).rounds;
+    });
+    report("simple_strategy_game", games, 1,
+      ",\"games_per_sec\":" + to_string(games.iterations / games.seconds));
+  }
+
+  {
+    // The same games on one HeadlessGame, reset in place between them
+    HeadlessGame game{"cccc"};
+    GameResult result;
+    unsigned gameSeed = seed;
+    const BenchResult games = measure([&game, &result, &gameSeed]() {
+      game.play(gameSeed++, result);
+      sink += result.rounds;
+    });
+    report("simple_strategy_game_reused", games, 1,
+      ",\"games_per_sec\":" + to_string(games.iterations / games.seconds) +
+      ",\"bytes_per_game\":" + to_string(game.getMemory()));
+  }
+
+  {
+    // The same games on the compile-time core
+    unsigned gameSeed = seed;
+    const BenchResult games = measure([&gameSeed]() {
+      sink += playCoreGame("cccc", gameSeed++).rounds;
+    });
+    report("simple_strategy_game_core", games, 1,
+      ",\"games_per_sec\":" + to_string(games.iterations / games.seconds));
+  }
+
+  {
+    // The same games again, a batch at a time in lockstep
+    BatchSimulator batch;
+    vector<unsigned> seeds(BatchSimulator::BATCH_GAMES);
+    unsigned gameSeed = seed;
+    const BenchResult batches = measure([&batch, &seeds, &gameSeed]() {
+      for (unsigned &s : seeds) s = gameSeed++;
+      for (const GameResult &result : batch.play(seeds)) sink += result.rounds;
+    });
+    report("simple_strategy_game_batch", batches, seeds.size(),
+      ",\"games_per_sec\":" +
+      to_string(batches.iterations * seeds.size() / batches.seconds));
+  }
+
+  {
+    // Every decision of rounds the heuristic plays against itself
+    struct Position {
+      CardMask hand;
+      PileBounds piles[NUM_SUITS];
+    };
+    vector<Position> positions;
+    Deck deck{seed};
+    for (int round = 0; round < 8; round++) {
+      deck.shuffle();
+      SimState state;
+      for (int i = 0; i < NUM_CARDS; i++) {
+        state.hands[i / RANKS_PER_SUIT] |= cardBit(deck.getOrder()[i]);
+      }
+      while (!state.isRoundOver()) {
+        Position p;
+        p.hand = state.hands[state.toMove];
+        for (int suit = 0; suit < NUM_SUITS; suit++) p.piles[suit] = state.piles[suit];
+        positions.push_back(p);
+        state.apply(chooseHeuristicMove(p.hand, p.piles));
+      }
+    }
+    bench("heuristic_decision", positions.size(), [&positions]() {
+      for (const Position &p : positions) sink += chooseHeuristicMove(p.hand, p.piles);
+    });
+  }
+
+  {
+    // Games with the heuristic in each seat in turn, against SimpleStrategy
+    const string seatings[NUM_SEATS] = {"tccc", "ctcc", "cctc", "ccct"};
+    unsigned gameSeed = seed;
+    double wins = 0;
+    const BenchResult games = measure([&gameSeed, &wins, &seatings]() {
+      for (int seat = 0; seat < NUM_SEATS; seat++) {
+        const GameResult result = playHeadlessGame(seatings[seat], gameSeed++);
+        const int winners = count(result.won.begin(), result.won.end(), true);
+        // Ties share the win
+        if (result.won[seat]) wins += 1.0 / winners;
+      }
+    });
+    report("heuristic_vs_simple", games, NUM_SEATS,
+      ",\"win_rate\":" + to_string(wins / (games.iterations * NUM_SEATS)));
+  }
+
+  {
+    // Following a round of SimpleStrategy from one seat, working out the
+    // chances of every hidden card after each move
+    StraightsModel model{seed};
+    NullView view;
+    StraightsController controller{view, model};
+    controller.initializePlayers("cccc");
+    vector<Player *> seats;
+    model.forEachPlayer([&seats](Player &p) { seats.push_back(&p); });
+    model.shuffleDeck();
+    model.dealHands();
+    const DeckOrder order = model.getDealOrder();
+    const vector<Move> moves = simpleRound(model, seats);
+    HandInference inference;
+    double chances[NUM_SEATS][NUM_CARDS];
+    bench("hand_inference_turn", moves.size(), [&]() {
+      model.resetRound();
+      model.dealHands(order);
+      for (const Move &m : moves) {
+        const int index = m.card->getIndex();
+        model.makeMove(*m.player, m.discard ? discardMove(index) : playMove(index));
+        inference.sync(model, 0);
+        inference.handProbabilities(chances);
+        sink += chances[1][index] > 0;
+      }
+    });
+  }
+
+  {
+    // Move generation over the whole tree of a deal, on one thread
+    const SimState start = perftStart(seed, ShuffleMode::LEGACY);
+    const uint64_t nodes = perft(start, 10, 1).nodes();
+    bench("perft_depth_10_node", nodes, [&]() {
+      sink += perft(start, 10, 1).leaves.back();
+    });
+  }
+
+  {
+    // Solving the last 16 cards of rounds played by SimpleStrategy
+    const int endgameCards = 16;
+    StraightsModel model{seed};
+    NullView view;
+    StraightsController controller{view, model};
+    controller.initializePlayers("cccc");
+    vector<Player *> seats;
+    model.forEachPlayer([&seats](Player &p) { seats.push_back(&p); });
+    vector<SimState> endgames;
+    for (int round = 0; round < 8; round++) {
+      model.resetRound();
+      model.shuffleDeck();
+      model.dealHands();
+      const ModelSnapshot dealt = model.snapshot();
+      const vector<Move> moves = simpleRound(model, seats);
+      model.restore(dealt);
+      const unsigned played = NUM_CARDS - endgameCards;
+      for (unsigned i = 0; i < played; i++) {
+        const Move &m = moves[i];
+        if (m.discard) model.discardCard(*m.player, *m.card);
+        else model.playCard(*m.player, *m.card);
+      }
+      endgames.push_back(model.getSimState(*moves[played].player));
+    }
+    // Each position is solved cold, with a new table, as at the first
+    // turn the solver takes over
+    EndgameStats stats;
+    const BenchResult solves = measure([&stats, &endgames]() {
+      for (const SimState &state : endgames) {
+        EndgameSolver solver{EndgameConfig{}.tableBits};
+        int value;
+        sink += solver.solve(state, value);
+        const EndgameStats &s = solver.getStats();
+        stats.nodes += s.nodes;
+        stats.probes += s.probes;
+        stats.hits += s.hits;
+        stats.seconds += s.seconds;
+      }
+    });
+    report("endgame_solve_16", solves, endgames.size(),
+      ",\"nodes_per_sec\":" + to_string(stats.nodesPerSecond()) +
+      ",\"tt_hit_rate\":" + to_string(stats.hitRate()));
+  }
+}
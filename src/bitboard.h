@@ -0,0 +1,97 @@
+#ifndef _H_BITBOARD
+#define _H_BITBOARD
+
+/*
+Compact bit representation of sets of cards. Each of the 52 cards has an
+index, (suit - 1) * 13 + (rank - 1), and a set of cards is a 64-bit mask
+with the bit at each card's index set.
+*/
+
+#include <cstdint>
+
+typedef uint64_t CardMask;
+
+const int NUM_CARDS = 52;
+const int NUM_SUITS = 4;
+const int RANKS_PER_SUIT = 13;
+// Rank that starts a new pile
+const int STARTING_RANK = 7;
+// Used in owner tables for cards not in anyone's hand
+const int8_t NO_OWNER = -1;
+
+// Index of the card with the given suit and rank, where suits and ranks
+// both start at 1 (as they do in the Suit and Rank enums).
+inline constexpr int cardIndex(int suit, int rank) {
+  return (suit - 1) * RANKS_PER_SUIT + (rank - 1);
+}
+
+inline constexpr int suitOfIndex(int index) {
+  return index / RANKS_PER_SUIT + 1;
+}
+
+inline constexpr int rankOfIndex(int index) {
+  return index % RANKS_PER_SUIT + 1;
+}
+
+inline constexpr CardMask cardBit(int index) {
+  return CardMask{1} << index;
+}
+
+// All the cards of one suit
+inline constexpr CardMask suitMask(int suit) {
+  return ((CardMask{1} << RANKS_PER_SUIT) - 1) << cardIndex(suit, 1);
+}
+
+const CardMask ALL_CARDS = (CardMask{1} << NUM_CARDS) - 1;
+
+// The card of the given rank in every suit
+inline constexpr CardMask rankMask(int rank) {
+  return cardBit(cardIndex(1, rank)) | cardBit(cardIndex(2, rank)) |
+         cardBit(cardIndex(3, rank)) | cardBit(cardIndex(4, rank));
+}
+
+// Index of the lowest card in a non-empty mask
+inline int lowestCard(CardMask mask) {
+  return __builtin_ctzll(mask);
+}
+
+inline int cardCount(CardMask mask) {
+  return __builtin_popcountll(mask);
+}
+
+// The extent of a suit's pile on the table. Both ranks are 0 while the
+// pile is empty; otherwise the pile holds every rank from low to high.
+struct PileBounds {
+  uint8_t low = 0;
+  uint8_t high = 0;
+  bool empty() const { return low == 0; }
+};
+
+// Cards that could legally be played on a pile of the given suit
+inline CardMask playableOnPile(int suit, PileBounds pile) {
+  if (pile.empty()) return cardBit(cardIndex(suit, STARTING_RANK));
+  CardMask mask = 0;
+  if (pile.low > 1) mask |= cardBit(cardIndex(suit, pile.low - 1));
+  if (pile.high < RANKS_PER_SUIT) mask |= cardBit(cardIndex(suit, pile.high + 1));
+  return mask;
+}
+
+// Cards that could legally be played on any of the four piles,
+// indexed by suit - 1
+inline CardMask playableMask(const PileBounds piles[NUM_SUITS]) {
+  CardMask mask = 0;
+  for (int suit = 1; suit <= NUM_SUITS; suit++) {
+    mask |= playableOnPile(suit, piles[suit - 1]);
+  }
+  return mask;
+}
+
+// Cards on a pile with the given bounds
+inline CardMask pileMask(int suit, PileBounds pile) {
+  if (pile.empty()) return 0;
+  const CardMask upToHigh = (CardMask{1} << pile.high) - 1;
+  const CardMask belowLow = (CardMask{1} << (pile.low - 1)) - 1;
+  return (upToHigh & ~belowLow) << cardIndex(suit, 1);
+}
+
+#endif
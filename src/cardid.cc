@@ -0,0 +1,50 @@
+#include "cardid.h"
+
+namespace {
+  // Rank and suit of each ASCII character, or 0 if it doesn't name one.
+  // Ten is the only two character rank, and is handled separately.
+  struct CharTables {
+    uint8_t rank[128];
+    uint8_t suit[128];
+    constexpr CharTables() : rank{}, suit{} {
+      for (int r = 1; r <= RANKS_PER_SUIT; r++) {
+        if (r != 10) rank[static_cast<int>(RANK_NAMES[r][0])] = r;
+      }
+      for (int s = 1; s <= NUM_SUITS; s++) {
+        suit[static_cast<int>(SUIT_NAMES[s])] = s;
+      }
+    }
+  };
+  constexpr CharTables TABLES{};
+
+  inline int lookup(const uint8_t table[128], char c) {
+    const unsigned char u = c;
+    return u < 128 ? table[u] : 0;
+  }
+}
+
+CardId parseCardId(const char *name, const size_t length) {
+  int rank;
+  if (length == 2) {
+    rank = lookup(TABLES.rank, name[0]);
+  } else if (length == 3) {
+    rank = (name[0] == '1' && name[1] == '0') ? 10 : 0;
+  } else {
+    return CardId{};
+  }
+  const int suit = lookup(TABLES.suit, name[length - 1]);
+  if (rank == 0 || suit == 0) return CardId{};
+  return CardId::of(suit, rank);
+}
+
+size_t formatCardId(const CardId card, char *out) {
+  size_t length = 0;
+  if (card.valid()) {
+    for (const char *c = RANK_NAMES[card.rank()]; *c; c++) {
+      out[length++] = *c;
+    }
+    out[length++] = SUIT_NAMES[card.suit()];
+  }
+  out[length] = '\0';
+  return length;
+}
@@ -0,0 +1,50 @@
+#ifndef _H_CARDID
+#define _H_CARDID
+
+/*
+A card as a single byte: its index from 0 (AC) to 51 (KS), the same index
+used by CardMask. Rank and suit names come from constant tables, and
+cards can be parsed and formatted without allocating.
+*/
+
+#include <cstdint>
+#include <cstddef>
+
+#include "bitboard.h"
+
+// Rank names, indexed by rank (1 to 13)
+constexpr const char *RANK_NAMES[RANKS_PER_SUIT + 1] = {
+  "", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K"
+};
+// Suit letters, indexed by suit (1 to 4)
+constexpr char SUIT_NAMES[NUM_SUITS + 1] = {'\0', 'C', 'D', 'H', 'S'};
+// Longest card name ("10H") plus a terminating null
+const size_t CARD_NAME_SIZE = 4;
+
+struct CardId {
+  static const uint8_t INVALID = 0xFF;
+  uint8_t value = INVALID;
+
+  constexpr CardId() {}
+  explicit constexpr CardId(int index) : value(index) {}
+  static constexpr CardId of(int suit, int rank) {
+    return CardId{cardIndex(suit, rank)};
+  }
+  constexpr bool valid() const { return value < NUM_CARDS; }
+  constexpr int index() const { return value; }
+  constexpr int suit() const { return suitOfIndex(value); }
+  constexpr int rank() const { return rankOfIndex(value); }
+  constexpr CardMask bit() const { return cardBit(value); }
+  constexpr bool operator==(CardId other) const { return value == other.value; }
+  constexpr bool operator!=(CardId other) const { return value != other.value; }
+};
+
+// Parses names like "7S" or "10H". Returns an invalid CardId for anything
+// else, including names with trailing characters.
+CardId parseCardId(const char *name, size_t length);
+
+// Writes the card's name and a terminating null into out, which must hold
+// CARD_NAME_SIZE characters. Returns the length of the name.
+size_t formatCardId(CardId card, char *out);
+
+#endif
@@ -1,3 +1,4 @@
+#include <iomanip>
 #include <map>
 
 #include "controller.h"
@@ -5,14 +6,69 @@
 #include "player.h"
 #include "view.h"
 #include "debug.h"
+#include "mcts.h"
+#include "endgame.h"
+#include "heuristic.h"
+#include "gamerecord.h"
+#include "alloccount.h"
+#include "trace.h"
 
 const unsigned NUMBER_OF_PLAYERS = 4;
 const std::string DIVIDER = "----------------------------------------";
+// Built once, so that headless rounds don't allocate them
+const std::string NEW_ROUND = UNDERLINE + "A new round begins." + RESET;
+const std::string SCORES = MAGENTA + BOLD + UNDERLINE + "Scores:" + RESET;
 
-StraightsController::StraightsController(View& view, StraightsModel& model) :
-  view{view}, model{model}
+StraightsController::StraightsController(View& view, StraightsModel& model,
+                                         const StrategyOptions options) :
+  view{view}, model{model}, strategyOptions{options}
 {}
 
+bool StraightsController::isComputerType(const char type) {
+  return type == 'c' || type == 'm' || type == 'e' || type == 't';
+}
+
+bool StraightsController::addPlayer(const char type, const unsigned i) {
+  if (type == 'h' || isComputerType(type)) playerTypes += type;
+  if (type == 'h') {
+    model.addPlayer(std::make_unique<HumanPlayer>(
+      "Player" + std::to_string(i)));
+    return true;
+  } else if (type == 'c') {
+    // Create computer player with SimpleStrategy
+    auto strategy = std::make_unique<SimpleStrategy>(view, model);
+    model.addPlayer(std::make_unique<ComputerPlayer>(
+      "Computer" + std::to_string(i),
+      std::move(strategy)
+    ));
+    return true;
+  } else if (type == 'm') {
+    auto strategy = std::make_unique<MctsStrategy>(view, model,
+      strategyOptions.mcts);
+    model.addPlayer(std::make_unique<ComputerPlayer>(
+      "Computer" + std::to_string(i),
+      std::move(strategy)
+    ));
+    return true;
+  } else if (type == 'e') {
+    auto strategy = std::make_unique<EndgameStrategy>(view, model,
+      strategyOptions.endgame, std::make_unique<SimpleStrategy>(view, model));
+    model.addPlayer(std::make_unique<ComputerPlayer>(
+      "Computer" + std::to_string(i),
+      std::move(strategy)
+    ));
+    return true;
+  } else if (type == 't') {
+    auto strategy = std::make_unique<HeuristicStrategy>(view, model);
+    model.addPlayer(std::make_unique<ComputerPlayer>(
+      "Computer" + std::to_string(i),
+      std::move(strategy)
+    ));
+    return true;
+  }
+  return false;
+}
+
 void StraightsController::initializePlayers(void) {
   for (unsigned i = 1; i <= NUMBER_OF_PLAYERS; i++) {
     view.displayMessage("Is Player " + std::to_string(i) +
@@ -20,17 +76,7 @@ void StraightsController::initializePlayers(void) {
       std::string command;
     while(true) {
       command = view.promptCommand();
-      if (command == "h") {;
-        model.addPlayer(std::make_unique<HumanPlayer>(
-          "Player" + std::to_string(i)));
-        break;
-      } else if (command == "c") {
-        // Create computer player with SimpleStrategy
-        auto strategy = std::make_unique<SimpleStrategy>(view, model);
-        model.addPlayer(std::make_unique<ComputerPlayer>(
-          "Computer" + std::to_string(i),
-          std::move(strategy)
-        ));
+      if (command.size() == 1 && addPlayer(command[0], i)) {
         break;
       } else {
         view.displayError("Invalid Option");
@@ -39,13 +85,19 @@ void StraightsController::initializePlayers(void) {
   }
 }
 
+void StraightsController::initializePlayers(const std::string &types) {
+  if (types.size() != NUMBER_OF_PLAYERS) throw InvalidPlayerType{};
+  for (char type : types) {
+    if (type != 'h' && !isComputerType(type)) throw InvalidPlayerType{};
+  }
+  for (unsigned i = 1; i <= NUMBER_OF_PLAYERS; i++) {
+    addPlayer(types[i - 1], i);
+  }
+}
+
 
 void StraightsController::handlePlayer(HumanPlayer& p) {
-  if (model.isEndOfRound()) {
-    Debug::print("End of round reached");
-    setLoopFlag(false);
-    return;
-  }
+  view.beginTurn(p.getName());
   view.displayMessage(DIVIDER);
   view.displayMessage("It's "+YELLOW+p.getName()+RESET+"'s turn to play");
   view.displayBoard(model.getClubsPile(), model.getDiamondsPile(),
@@ -54,26 +106,12 @@ void StraightsController::handlePlayer(HumanPlayer& p) {
   view.displayHand(hand);
   if(hand.empty()) return;
   view.displayLegalPlays(model.getLegalPlays(p));
-  while (true) {
-    std::string command = view.promptCommand();
-    if (command == "play") {
-      if (play(p)) break;
-    } else if (command == "discard") {
-      if (discard(p)) break;
-    } else if (command == "deck") {
-      if (printDeck()) break;
-    } else if (command == "quit") {
-      if (quit()) break;
-    } else if (command == "ragequit") {
-      if (ragequit(p)) break;
-    } else {
-      view.displayError("Invalid Command"); 
-    }
-  }
+  // The turn goes on in input(), once the player has typed a command
+  waitingOn = &p;
+  phase = Phase::COMMAND;
 }
 
-bool StraightsController::play(HumanPlayer& p) {
-  const std::string cardstr = view.promptCardSelection();
+bool StraightsController::play(HumanPlayer& p, const std::string &cardstr) {
   Card* cardptr = model.getCard(cardstr);
   if (!cardptr) {
         view.displayError("Invalid Command");
@@ -90,19 +128,18 @@ bool StraightsController::play(HumanPlayer& p) {
   return true;
 }
 
-bool StraightsController::discard(HumanPlayer& p) {
-  const std::string cardstr = view.promptCardSelection();
+bool StraightsController::discard(HumanPlayer& p, const std::string &cardstr) {
   Card* cardptr = model.getCard(cardstr);
-  if (!cardptr && model.whoHasCard(*cardptr) != &p) {
+  if (!cardptr || model.whoHasCard(*cardptr) != &p) {
     view.displayError("Invalid Command");
     return false;
   }
-  if (!model.getLegalPlays(p).empty()) {
+  if (model.getLegalPlayMask(p)) {
     view.displayError("You have a legal play. You may not discard.");
     return false;
   }
   view.displayMessage(YELLOW+p.getName()+RESET+" discards "+cardstr);
-  p.discardCard(*cardptr);
+  model.discardCard(p, *cardptr);
   return true;
 }
 
@@ -112,10 +149,11 @@ bool StraightsController::printDeck() {
 }
 
 bool StraightsController::quit() {
-  // The model will stop looping
+  // The game stops at the end of this input
   Debug::print("Exiting...");
-  setLoopFlag(false);
   quitFlag = true;
+  if (singleRound) phase = Phase::OVER;
+  else endGame();
   return true;
 }
 
@@ -125,87 +163,252 @@ bool StraightsController::ragequit(HumanPlayer& p) {
   Player* newPlayer = model.replacePlayer(p, std::make_unique<ComputerPlayer>(
     p.getName() + "'s Ghost", std::make_unique<SimpleStrategy>(view, model)
   ));
-  // Do another round
-  Debug::print("We doin another round");
+  // The computer plays the rest of this turn
   newPlayer->accept(*this);
-  Debug::print("We doin another round");
   return true;
 }
 
 void StraightsController::handlePlayer(ComputerPlayer& p) {
-  if (model.isEndOfRound()) {
-    Debug::print("End of round reached");
-    setLoopFlag(false);
+  TraceScope trace{TraceSpan::TURN};
+  if (!allocStats) {
+    p.doTurn();
     return;
   }
+  const uint64_t before = AllocCounter::count();
   p.doTurn();
+  allocStats->addTurn(AllocCounter::count() - before);
 }
 
 void SimpleStrategy::doTurn(ComputerPlayer &p) {
   const std::vector<Card*>& hand = p.getHand();
   if (hand.empty()) return;
-  view.displayMessage(DIVIDER);
-  const std::vector<Card*>& legalPlays = model.getLegalPlays(p);
-  if (!legalPlays.empty()) {
-    Card* cardToPlay = legalPlays[0];
-    model.playCard(p, *cardToPlay);
-    view.displayMessage(YELLOW+p.getName()+RESET+" plays "+ cardToPlay->getStringRep());
-  } else {
-    Card* cardToDiscard = hand[0];
-    p.discardCard(*cardToDiscard);
-    view.displayMessage(YELLOW+p.getName()+RESET+" discards "+ cardToDiscard->getStringRep());
+  // Plays the first legal card in hand order
+  const CardMask legal = model.getLegalPlayMask(p);
+  if (legal) {
+    for (Card *card : hand) {
+      if (legal & cardBit(card->getIndex())) {
+        playCard(p, *card);
+        return;
+      }
+    }
   }
+  discardCard(p, *hand[0]);
 }
 
 void StraightsController::startGameLoop(void) {
   initializePlayers();
+  playGame();
+}
+
+void StraightsController::playGame(void) {
+  beginGame();
+  for (InputRequest r = advance(); r != InputRequest::NONE;) {
+    r = input(r == InputRequest::COMMAND ? view.promptCommand() :
+                                           view.promptCardSelection());
+  }
+}
+
+bool StraightsController::playRound(void) {
+  beginGame(true);
+  for (InputRequest r = advance(); r != InputRequest::NONE;) {
+    r = input(r == InputRequest::COMMAND ? view.promptCommand() :
+                                           view.promptCardSelection());
+  }
+  return !quitFlag;
+}
+
+void StraightsController::resetGame(const unsigned seed) {
+  model.resetGame(seed);
+  roundsPlayed = 0;
+  phase = Phase::IDLE;
+}
+
+void StraightsController::beginGame(const bool oneRound) {
+  singleRound = oneRound;
+  quitFlag = false;
+  waitingOn = nullptr;
+  phase = Phase::ROUND_START;
+  if (oneRound) return;
+  gameAllocationsBefore = AllocCounter::count();
+  gameTimer.begin();
+  if (recorder) {
+    recorder->beginGame(model.getSeed(), model.getShuffleMode(), playerTypes);
+  }
+}
+
+void StraightsController::startRound() {
+  roundAllocationsBefore = AllocCounter::count();
+  roundTimer.begin();
+  model.shuffleDeck();
+  model.dealHands();
+  if (recorder) recorder->beginRound(model.getDealOrder());
+  const Card* sevenOfSpades = model.getCard(CardId::of(SPADES, SEVEN));
+  seat = model.getSeat(*model.whoHasCard(*sevenOfSpades));
+  view.displayMessage(NEW_ROUND);
+  phase = Phase::NEXT_TURN;
+}
+
+void StraightsController::endRound() {
+  roundsPlayed++;
+  if (recorder) recorder->endRound();
+  // Check scores to see if game must be quit
+  // otherwise start another round
+  Debug::print("Printing player scores");
+  view.displayMessage(DIVIDER);
+  view.displayMessage(SCORES);
+  model.forEachPlayer([this](Player &p) {
+    view.displayScore(p.getName(), p.getDiscards(),
+    p.getTotalScore() - p.getRoundScore(), p.getRoundScore());
+  });
+  view.displayMessage(DIVIDER);
+  if (allocStats) allocStats->addRound(AllocCounter::count() - roundAllocationsBefore);
+  roundTimer.end();
+}
+
+void StraightsController::endGame() {
+  if (recorder) recorder->endGame();
+  if (allocStats) allocStats->addGame(AllocCounter::count() - gameAllocationsBefore);
+  gameTimer.end();
+  phase = Phase::OVER;
+}
+
+void StraightsController::nextTurn() {
+  waitingOn = nullptr;
+  seat = (seat + 1) % model.getPlayerCount();
+  phase = Phase::NEXT_TURN;
+}
+
+InputRequest StraightsController::advance() {
   while (true) {
-    // Round starts here
-    model.shuffleDeck();
-    model.dealHands();
-    const Card* sevenOfSpades = model.getCard("7S");
-    Player* const start = model.whoHasCard(*sevenOfSpades);
-    view.displayMessage(UNDERLINE+"A new round begins."+RESET);
-    setLoopFlag(true);
-    // This command consists of one round.
-    model.loopThroughPlayers(start, *this);
-    // Used to quit the game
-    if (quitFlag) return;
-    // Check scores to see if game must be quit
-    // otherwise start another round
-    Debug::print("Printing player scores");
-    view.displayMessage(DIVIDER);
-    view.displayMessage(MAGENTA + BOLD + UNDERLINE + "Scores:" + RESET);
-    model.forEachPlayer([this](Player &p) {
-      view.displayScore(p.getName(), p.getDiscards(),
-      p.getTotalScore() - p.getRoundScore(), p.getRoundScore());
-    });
-    view.displayMessage(DIVIDER);
-    if (model.isEndOfGame()) {
-      auto winners = model.getWinners();
-      for (auto& p : winners) {
-        view.displayWin(p->getName());
-      }
-      break;
+    switch (phase) {
+      case Phase::ROUND_START:
+        startRound();
+        break;
+      case Phase::NEXT_TURN:
+        if (model.isEndOfRound()) {
+          Debug::print("End of round reached");
+          endRound();
+          if (singleRound) {
+            phase = Phase::OVER;
+          } else if (model.isEndOfGame()) {
+            const int lowest = model.getLowestScore();
+            model.forEachPlayer([this, lowest](Player &p) {
+              if (p.getTotalScore() == lowest) view.displayWin(p.getName());
+            });
+            endGame();
+          } else {
+            model.resetRound();
+            phase = Phase::ROUND_START;
+          }
+          break;
+        }
+        model.getPlayer(seat).accept(*this);
+        // Computers finish their turns straight away
+        if (phase == Phase::NEXT_TURN) nextTurn();
+        break;
+      case Phase::COMMAND:
+        return InputRequest::COMMAND;
+      case Phase::CARD:
+        return InputRequest::CARD;
+      default:
+        return InputRequest::NONE;
     }
-    model.resetRound();
   }
 }
 
-PlayerHandler::~PlayerHandler() {}
+InputRequest StraightsController::input(const std::string &word) {
+  if (phase == Phase::COMMAND) {
+    HumanPlayer &p = *waitingOn;
+    if (word == "play" || word == "discard") {
+      command = word;
+      phase = Phase::CARD;
+    } else if (word == "deck") {
+      // Ends the turn without a move, as it always has
+      printDeck();
+      nextTurn();
+    } else if (word == "quit") {
+      quit();
+    } else if (word == "ragequit") {
+      ragequit(p);
+      nextTurn();
+    } else {
+      view.displayError("Invalid Command");
+    }
+  } else if (phase == Phase::CARD) {
+    HumanPlayer &p = *waitingOn;
+    const bool moved = command == "play" ? play(p, word) : discard(p, word);
+    if (moved) nextTurn();
+    else phase = Phase::COMMAND;
+  }
+  return advance();
+}
+
+InputRequest StraightsController::waitingFor() const {
+  if (phase == Phase::COMMAND) return InputRequest::COMMAND;
+  if (phase == Phase::CARD) return InputRequest::CARD;
+  return InputRequest::NONE;
+}
+
+HumanPlayer *StraightsController::getWaitingPlayer() const {
+  return waitingOn;
+}
 
-void PlayerHandler::setLoopFlag(const bool b) {
-  loopFlag = b;
+unsigned StraightsController::getRoundsPlayed() const {
+  return roundsPlayed;
 }
 
-bool PlayerHandler::shouldLoop() const {
-  return loopFlag;
+void StraightsController::setAllocStats(AllocStats *stats) {
+  allocStats = stats;
 }
 
+void StraightsController::setRecorder(GameRecorder *r) {
+  recorder = r;
+  model.setObserver(r);
+}
+
+PlayerHandler::~PlayerHandler() {}
+
 TurnStrategy::TurnStrategy(View& view, StraightsModel &model) :
   view{view}, model{model}
 {}
 
+void TurnStrategy::resetGame() {}
+
+void TurnStrategy::addStats(StrategyStats &) const {}
+
+void StrategyStats::merge(const StrategyStats &other) {
+  ponderHits += other.ponderHits;
+  ponderMisses += other.ponderMisses;
+  endgame.merge(other.endgame);
+}
+
+void StrategyStats::print(std::ostream &out) const {
+  const uint64_t pondered = ponderHits + ponderMisses;
+  if (pondered > 0) {
+    out << "ponder: hits " << ponderHits << " misses " << ponderMisses
+        << " hit rate " << std::fixed << std::setprecision(3)
+        << static_cast<double>(ponderHits) / pondered << std::endl;
+  }
+  if (endgame.solves > 0) {
+    out << "endgame: solves " << endgame.solves << " nodes " << endgame.nodes
+        << " nodes/sec " << std::setprecision(0) << endgame.nodesPerSecond()
+        << " table hit rate " << std::setprecision(3) << endgame.hitRate()
+        << std::endl;
+  }
+}
+
+void TurnStrategy::playCard(ComputerPlayer &p, Card &card) {
+  view.displayMessage(DIVIDER);
+  model.playCard(p, card);
+  view.displayMove(p.getName(), card, false);
+}
+
+void TurnStrategy::discardCard(ComputerPlayer &p, Card &card) {
+  view.displayMessage(DIVIDER);
+  model.discardCard(p, card);
+  view.displayMove(p.getName(), card, true);
+}
+
 SimpleStrategy::SimpleStrategy(View& view, StraightsModel &model) :
   TurnStrategy(view, model)
 {}
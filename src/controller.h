@@ -6,46 +6,187 @@
  Between a View and the game Model.
 
  The Controller also acts as a Visitor, which performs handlePlayer on
- all Player elements within the model when StraightsModel::loopThroughPlayers
- is called.
+ the Player whose turn it is.
+
+ A game is a resumable state machine: advance() runs computer turns until
+ a human has to type something, and input() takes what they typed. Nothing
+ blocks in between, so a server can run many games on a few threads.
+ playGame() drives the same machine with the View's blocking prompts.
 */
 
+#include <string>
+#include <exception>
+#include <iostream>
+
+#include <cstdint>
+
+#include "trace.h"
+
 class StraightsModel;
 class View;
 class HumanPlayer;
 class ComputerPlayer;
 class Player;
+class Card;
+class GameRecorder;
+struct AllocStats;
+
+// Settings for MctsStrategy (see mcts.h)
+struct MctsConfig {
+  // Playouts per decision, split between the threads
+  unsigned iterations = 1000;
+  // If non-zero, each decision searches for this long instead
+  unsigned milliseconds = 0;
+  // Independent trees searched in parallel (root parallelism). 0 is
+  // taken as 1, unlike elsewhere, so the moves chosen don't depend on
+  // the number of cores.
+  unsigned threads = 1;
+  // UCB exploration constant
+  double exploration = 0.7;
+  uint64_t seed = 1;
+  // Search likely next positions while other seats move
+  bool ponder = false;
+};
+
+// Settings for EndgameStrategy (see endgame.h)
+struct EndgameConfig {
+  // The solver takes over once this many cards are left in all hands
+  unsigned cards = 16;
+  // The transposition table holds 2^tableBits entries
+  unsigned tableBits = 18;
+};
+
+// Settings for the strategies of computer players
+struct StrategyOptions {
+  MctsConfig mcts;
+  EndgameConfig endgame;
+};
+
+// Totals over the solves an EndgameSolver has done
+struct EndgameStats {
+  uint64_t solves = 0;
+  uint64_t nodes = 0;
+  uint64_t probes = 0;
+  uint64_t hits = 0;
+  double seconds = 0;
+  double nodesPerSecond() const;
+  // Fraction of table probes that found their position
+  double hitRate() const;
+  void merge(const EndgameStats &other);
+};
+
+// What the strategies of computer players did, over every game played
+struct StrategyStats {
+  // Turns MctsStrategy answered with a pondered reply, and turns it had
+  // to search for while pondering
+  uint64_t ponderHits = 0;
+  uint64_t ponderMisses = 0;
+  // Solves of every EndgameStrategy
+  EndgameStats endgame;
+  void merge(const StrategyStats &other);
+  // Prints a line for each kind of work that was done
+  void print(std::ostream &out) const;
+};
 
 class PlayerHandler {
-  bool loopFlag = true;
-protected:
-  // Used in handlePlayer to stop StraightModel::loopThroughPlayers
-  // from looping
-  void setLoopFlag(bool b);
 public:
-  // In StraightsModel::loopThroughPlayers, this is used to check if
-  // It should keep looping through players.
-  bool shouldLoop() const;
   virtual void handlePlayer(HumanPlayer& p) = 0;
   virtual void handlePlayer(ComputerPlayer& p) = 0;
   virtual ~PlayerHandler();
 };
 
+// What a game is waiting for from the player whose turn it is
+enum class InputRequest {
+  // A command: play, discard, deck, quit or ragequit
+  COMMAND,
+  // The card to play or discard
+  CARD,
+  // Nothing, as the game (or the single round) is over
+  NONE
+};
+
 class StraightsController: public PlayerHandler {
+  enum class Phase { IDLE, ROUND_START, NEXT_TURN, COMMAND, CARD, OVER };
   View& view;
   StraightsModel& model;
-  // Next four functions handle different commands the user can input
+  Phase phase = Phase::IDLE;
+  // Stop after the round being played, instead of the game
+  bool singleRound = false;
+  // Seat whose turn it is, and the human being waited on
+  int seat = 0;
+  HumanPlayer *waitingOn = nullptr;
+  // The command waiting for its card
+  std::string command;
+  uint64_t gameAllocationsBefore = 0;
+  uint64_t roundAllocationsBefore = 0;
+  TraceTimer gameTimer{TraceSpan::GAME};
+  TraceTimer roundTimer{TraceSpan::ROUND};
+  // Next functions handle different commands the user can input
   // They return whether they were successful or not.
-  bool play(HumanPlayer& p);
-  bool discard(HumanPlayer& p);
+  bool play(HumanPlayer& p, const std::string &cardstr);
+  bool discard(HumanPlayer& p, const std::string &cardstr);
   bool printDeck();
   bool quit();
   bool ragequit(HumanPlayer& p);
-  void initializePlayers(void);
+  void startRound();
+  // Shows the scores of a finished round
+  void endRound();
+  void endGame();
+  // Moves on to the next seat's turn
+  void nextTurn();
+  // Adds a player of the given type ('h', 'c', 'm', 'e' or 't') as the i'th seat.
+  // Returns false if the type is not recognized.
+  bool addPlayer(char type, unsigned i);
   bool quitFlag = false;
+  unsigned roundsPlayed = 0;
+  StrategyOptions strategyOptions;
+  // Type of each seat, in the order they were added
+  std::string playerTypes;
+  GameRecorder *recorder = nullptr;
+  AllocStats *allocStats = nullptr;
 public:
-  StraightsController(View& view, StraightsModel& model);
+  StraightsController(View& view, StraightsModel& model,
+                      StrategyOptions options = StrategyOptions{});
+  // True for the player types played by the computer: 'c' (SimpleStrategy),
+  // 'm' (MctsStrategy), 'e' (SimpleStrategy until the EndgameStrategy
+  // takes over) and 't' (HeuristicStrategy)
+  static bool isComputerType(char type);
+  // Prompts the view for the type of each player
+  void initializePlayers(void);
+  // Adds players without prompting, one seat per character of types.
+  // Throws InvalidPlayerType if types has the wrong length or an
+  // unrecognized character.
+  void initializePlayers(const std::string &types);
+  // Prompts for players, then plays a game
   void startGameLoop(void);
+  // Plays rounds until the game ends or a player quits, prompting the
+  // view whenever a human has to type something.
+  // The players must already be initialized.
+  void playGame(void);
+  // Shuffles, deals and plays a single round, then shows the scores.
+  // Returns false if a player quit during the round.
+  bool playRound(void);
+  // Starts a game (or a single round) without playing any of it.
+  // The players must already be initialized.
+  void beginGame(bool oneRound = false);
+  // Sets up a new game dealt from seed on the same model, players and
+  // strategies (see StraightsModel::resetGame). Call beginGame to start it.
+  void resetGame(unsigned seed);
+  // Plays until a human has to type something, and returns what.
+  // Returns InputRequest::NONE once the game is over.
+  InputRequest advance();
+  // Takes one word typed by the human being waited on, then advances
+  InputRequest input(const std::string &word);
+  // What advance() last returned
+  InputRequest waitingFor() const;
+  // The human being waited on, if any
+  HumanPlayer *getWaitingPlayer() const;
+  unsigned getRoundsPlayed() const;
+  // Records every game played from now on; nullptr stops recording
+  void setRecorder(GameRecorder *r);
+  // Counts the allocations of each computer turn, round and game from
+  // now on into stats; nullptr stops counting
+  void setAllocStats(AllocStats *stats);
   void handlePlayer(HumanPlayer& p) override;
   void handlePlayer(ComputerPlayer& p) override;
 };
@@ -55,9 +196,18 @@ class TurnStrategy {
 protected:
   View& view;
   StraightsModel& model;
+  // Makes the play or discard for p, and shows it on the view
+  void playCard(ComputerPlayer &p, Card &card);
+  void discardCard(ComputerPlayer &p, Card &card);
 public:
   TurnStrategy(View& view, StraightsModel &model);
   virtual void doTurn(ComputerPlayer &p) = 0;
+  // Called before each new game played on the same model. Strategies
+  // that keep state between turns start over, so that a reused game
+  // plays exactly like a new one.
+  virtual void resetGame();
+  // Adds what the strategy has done so far to stats
+  virtual void addStats(StrategyStats &stats) const;
   virtual ~TurnStrategy() = default;
 };
 
@@ -66,4 +216,11 @@ public:
   SimpleStrategy(View& view, StraightsModel &model);
   void doTurn(ComputerPlayer &p) override;
 };
+// Exceptions
+struct InvalidPlayerType: public std::exception {
+  const char* what() {
+    return "Player types must be one 'h', 'c', 'm', 'e' or 't' per seat.";
+  }
+};
+
 #endif
@@ -10,3 +10,10 @@ void Debug::print(const std::string msg) {
   return;
 }
 
+void Debug::print(const char *msg) {
+  #if DEBUG
+    print(std::string{msg});
+  #endif
+  return;
+}
+
@@ -17,6 +17,8 @@ class Debug {
   Debug() {};
 public:
   static void print(std::string msg);
+  // Avoids building a std::string when debugging is off
+  static void print(const char *msg);
 };
 
 #endif
@@ -5,128 +5,253 @@
 #include "deck.h"
 #include "player.h"
 #include "debug.h"
+#include "trace.h"
 
-// Amount of times that std::suffle shuffles the deck
-const int SHUFFLE_AMOUNT = 100;
-unsigned Deck::DEFAULT_SEED = 0;
-
-const std::map<Suit, std::string> suitMap = {
-  {CLUBS, "C"}, {DIAMONDS, "D"}, {HEARTS, "H"}, {SPADES, "S"}
-};
-const std::map<Rank, std::string> rankMap = {
-  {ACE, "A"}, {TWO, "2"}, {THREE, "3"}, {FOUR, "4"}, {FIVE, "5"},
-  {SIX, "6"}, {SEVEN, "7"}, {EIGHT, "8"}, {NINE, "9"}, {TEN, "10"},
-  {JACK, "J"}, {QUEEN, "Q"}, {KING, "K"}
-};
+const unsigned Deck::DEFAULT_SEED;
+const int LegacyShuffle::PASSES;
 
 Card::Card(const Rank rank, const Suit suit) :
-  rank{rank}, suit{suit}
+  id{willBeValidCard(rank, suit) ? CardId::of(suit, rank) : CardId{}}
 {
-  if (!willBeValidCard(rank, suit)) {
+  if (!id.valid()) {
     throw InvalidCard{};
   } 
-  rep = rankMap.at(rank) + suitMap.at(suit);
+}
+
+Card::Card(const CardId id) : id{id}
+{
+  if (!id.valid()) {
+    throw InvalidCard{};
+  }
 }
 
 Suit Card::getSuit() const {
-  return suit;
+  return static_cast<Suit>(id.suit());
 }
 
 bool Card::hasRank(Rank r) const {
-  return rank == r;
+  return id.rank() == r;
+}
+
+Rank Card::getRank() const {
+  return static_cast<Rank>(id.rank());
+}
+
+CardId Card::getId() const {
+  return id;
+}
+
+int Card::getIndex() const {
+  return id.index();
 }
 
 bool Card::willBeValidCard(const Rank rank, const Suit suit) {
-  try {
-    rankMap.at(rank);
-    suitMap.at(suit);
-    return true;
-  } catch (std::out_of_range const&) {
-    return false;
-  }
+  return rank >= ACE && rank <= KING && suit >= CLUBS && suit <= SPADES;
 }
 
 std::string Card::getStringRep() const {
-  return rep;
+  char name[CARD_NAME_SIZE];
+  const size_t length = formatCardId(id, name);
+  return std::string(name, length);
+}
+
+size_t Card::format(char *out) const {
+  return formatCardId(id, out);
 }
 
 int Card::getScore() const {
-  return rank;
+  return id.rank();
 }
 
 bool Card::isAdjacentTo(Card &c) const {
-  return (c.suit == suit) &&
-         (rank == c.rank + 1 || rank == c.rank - 1);
+  return (c.id.suit() == id.suit()) &&
+         (id.rank() == c.id.rank() + 1 || id.rank() == c.id.rank() - 1);
 }
 
 bool Card::isFrontAdjacentTo(Card &c) const {
-  return (c.suit == suit) && (rank == c.rank - 1);
+  return (c.id.suit() == id.suit()) && (id.rank() == c.id.rank() - 1);
 }
 
 bool Card::isBackAdjacentTo(Card &c) const {
-  return (c.suit == suit) && (rank == c.rank + 1);
+  return (c.id.suit() == id.suit()) && (id.rank() == c.id.rank() + 1);
 }
 
 
-std::ostream& operator<<(std::ostream& os, Card &card) {
-  os << card.getStringRep();
+std::ostream& operator<<(std::ostream& os, const Card &card) {
+  char name[CARD_NAME_SIZE];
+  os.write(name, card.format(name));
   return os;
 }
 
-Deck::Deck(const unsigned seed) {
-  unsigned newSeed = seed;
-  if (seed == 0) {
-    newSeed = std::chrono::system_clock::now().time_since_epoch().count();
+bool parseShuffleMode(const std::string &name, ShuffleMode &mode) {
+  const std::map<std::string, ShuffleMode> modes = {
+    {"legacy", ShuffleMode::LEGACY}, {"xoshiro", ShuffleMode::XOSHIRO},
+    {"pcg", ShuffleMode::PCG}, {"counter", ShuffleMode::COUNTER}
+  };
+  auto it = modes.find(name);
+  if (it == modes.end()) return false;
+  mode = it->second;
+  return true;
+}
+
+const char *shuffleModeName(const ShuffleMode mode) {
+  switch (mode) {
+    case ShuffleMode::XOSHIRO: return "xoshiro";
+    case ShuffleMode::PCG: return "pcg";
+    case ShuffleMode::COUNTER: return "counter";
+    default: return "legacy";
+  }
+}
+
+bool ShuffleEngine::skip(uint64_t) {
+  return false;
+}
+
+LegacyShuffle::LegacyShuffle(const unsigned seed) : rng{seed}
+{}
+
+void LegacyShuffle::shuffle(DeckOrder &order) {
+  // std::shuffle's result only depends on the length and the generator,
+  // so shuffling indices gives the same deals as shuffling the cards did
+  for (int i = 0; i < PASSES; i++) {
+    std::shuffle(order.begin(), order.end(), rng);
+  }
+}
+
+void LegacyShuffle::reseed(const unsigned seed) {
+  rng.seed(seed);
+}
+
+CounterShuffle::CounterShuffle(const unsigned seed) : rng{seed}
+{}
+
+void CounterShuffle::shuffle(DeckOrder &order) {
+  // Draws for shuffle n start at n * NUM_CARDS, with exactly one per swap,
+  // and the deck always starts in the standard order. This makes each
+  // shuffle depend on the seed and n alone.
+  rng.seek(shuffles * NUM_CARDS);
+  for (int i = 0; i < NUM_CARDS; i++) {
+    order[i] = i;
+  }
+  for (uint32_t i = NUM_CARDS - 1; i > 0; i--) {
+    const uint32_t j = ((rng() >> 32) * (i + 1)) >> 32;
+    std::swap(order[i], order[j]);
+  }
+  shuffles++;
+}
+
+bool CounterShuffle::skip(const uint64_t n) {
+  shuffles += n;
+  return true;
+}
+
+void CounterShuffle::reseed(const unsigned seed) {
+  rng = CounterRng{seed};
+  shuffles = 0;
+}
+
+std::unique_ptr<ShuffleEngine> makeShuffleEngine(const ShuffleMode mode,
+                                                 const unsigned seed) {
+  switch (mode) {
+    case ShuffleMode::XOSHIRO:
+      return std::make_unique<FisherYatesShuffle<Xoshiro256>>(seed);
+    case ShuffleMode::PCG:
+      return std::make_unique<FisherYatesShuffle<Pcg32>>(seed);
+    case ShuffleMode::COUNTER:
+      return std::make_unique<CounterShuffle>(seed);
+    case ShuffleMode::LEGACY:
+    default:
+      return std::make_unique<LegacyShuffle>(seed);
   }
-  Debug::print("Deck seed: " + std::to_string(newSeed));
-  rng = std::default_random_engine{newSeed};
+}
+
+Deck::Deck(const unsigned seed, const ShuffleMode mode) :
+  seed{seed}, mode{mode}
+{
+  if (seed == DEFAULT_SEED) {
+    this->seed = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+  Debug::print("Deck seed: " + std::to_string(this->seed));
+  shuffler = makeShuffleEngine(mode, this->seed);
   initializeStandardOrder();
 }
 
 void Deck::shuffle() {
-  for (int i = 0; i < SHUFFLE_AMOUNT; i++) {
-    std::shuffle(cards.begin(), cards.end(), rng);
-  }
+  TraceScope trace{TraceSpan::SHUFFLE};
+  shuffler->shuffle(order);
+}
+
+bool Deck::skipShuffles(const uint64_t n) {
+  return shuffler->skip(n);
+}
+
+void Deck::setOrder(const DeckOrder &newOrder) {
+  order = newOrder;
+}
+
+const DeckOrder &Deck::getOrder() const {
+  return order;
+}
+
+unsigned Deck::getSeed() const {
+  return seed;
+}
+
+ShuffleMode Deck::getShuffleMode() const {
+  return mode;
 }
 
 void Deck::dealCard(Player& p) {
-  try {
-    Card* cardPtr = cards.at(dealtCardIndex).get();
-    p.giveCard(*cardPtr);
-    dealtCardIndex++;
-  } catch (std::out_of_range& e) {
+  if (dealtCardIndex >= NUM_CARDS) {
     throw DeckIsEmpty{};
   }
+  p.giveCard(cards[order[dealtCardIndex]]);
+  dealtCardIndex++;
 }
 
 void Deck::reset() {
   dealtCardIndex = 0;
 }
 
-Card *Deck::getCard(const std::string rep) const {
-  try {
-    auto cardPtr = cardMap.at(rep);
-    return cardPtr;
-  } catch (std::out_of_range& e) {
-    return nullptr;
+void Deck::reseed(const unsigned newSeed) {
+  seed = newSeed;
+  if (seed == DEFAULT_SEED) {
+    seed = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+  shuffler->reseed(seed);
+  for (int index = 0; index < NUM_CARDS; index++) {
+    order[index] = index;
   }
+  dealtCardIndex = 0;
+}
+
+Card *Deck::getCard(const int index) const {
+  // Cards are immutable; players and piles just hold pointers to them
+  return const_cast<Card *>(&cards[index]);
+}
+
+Card *Deck::getCard(const CardId id) const {
+  if (!id.valid()) return nullptr;
+  return getCard(id.index());
+}
+
+Card *Deck::getCard(const std::string &rep) const {
+  return getCard(parseCardId(rep.data(), rep.size()));
 }
 
 void Deck::initializeStandardOrder() {
-  for (int suit = CLUBS; suit <= SPADES; suit++) {
-    for (int rank = ACE; rank <= KING; rank++) {
-      std::unique_ptr<Card> cardPtr = std::make_unique<Card>(
-          static_cast<Rank>(rank), static_cast<Suit>(suit));
-      cardMap[cardPtr->getStringRep()] = cardPtr.get();
-      cards.push_back(std::move(cardPtr));
-    }
+  // Reserved up front, so the cards never move
+  cards.reserve(NUM_CARDS);
+  for (int index = 0; index < NUM_CARDS; index++) {
+    cards.emplace_back(CardId{index});
+    order[index] = index;
   }
 }
 
 void Deck::printDeck(void) const {
   int i = 1;
-  for (auto& card : cards) {
-    std::cout << card->getStringRep() << " ";
+  for (const uint8_t index : order) {
+    std::cout << cards[index] << " ";
     if (i % 13 == 0) std::cout << std::endl;
     i++;
   }
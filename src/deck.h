@@ -6,12 +6,16 @@ Implementation for the deck of cards used.
 */
 
 #include <vector>
-#include <map>
 #include <iostream>
 #include <string>
 #include <memory>
 #include <random>
 #include <stdexcept>
+#include <array>
+
+#include "bitboard.h"
+#include "cardid.h"
+#include "rng.h"
 
 enum Suit {CLUBS = 1, DIAMONDS, HEARTS, SPADES};
 enum Rank {ACE = 1, TWO, THREE, FOUR, FIVE, SIX, SEVEN, EIGHT,
@@ -20,17 +24,24 @@ enum Rank {ACE = 1, TWO, THREE, FOUR, FIVE, SIX, SEVEN, EIGHT,
 class Player;
 
 class Card {
-  const Rank rank;
-  const Suit suit;
-  std::string rep;
-  bool willBeValidCard(Rank rank, Suit suit);
+  const CardId id;
+  static bool willBeValidCard(Rank rank, Suit suit);
 public:
   // Throws an InvalidCard error if the rank/suit are invalid.
   Card(Rank rank, Suit suit);
+  // Throws an InvalidCard error if the id is invalid.
+  explicit Card(CardId id);
   // Guaranteed to return either clubs, hearts, spades, or diamonds
   Suit getSuit() const;
   bool hasRank(Rank r) const;
+  Rank getRank() const;
+  CardId getId() const;
+  // Index of this card in a CardMask, from 0 (AC) to 51 (KS)
+  int getIndex() const;
   std::string getStringRep(void) const;
+  // Writes the name into out without allocating (see formatCardId).
+  // Returns the length of the name.
+  size_t format(char *out) const;
   int getScore() const;
   bool isAdjacentTo(Card &c) const;
   // Returns if the rank is one lower
@@ -39,29 +50,120 @@ public:
   bool isBackAdjacentTo(Card &c) const;
 };
 
-std::ostream& operator<<(std::ostream& os, Card &card);
+std::ostream& operator<<(std::ostream& os, const Card &card);
 
-class Deck {
+// The order of the cards in a deck, as card indices (see Card::getIndex)
+typedef std::array<uint8_t, NUM_CARDS> DeckOrder;
+
+enum class ShuffleMode {
+  // 100 std::shuffle passes with std::default_random_engine. Reproduces
+  // the deals of existing seeds.
+  LEGACY,
+  // One Fisher-Yates pass with xoshiro256**
+  XOSHIRO,
+  // One Fisher-Yates pass with PCG32
+  PCG,
+  // One Fisher-Yates pass with a counter-based generator. Every shuffle
+  // starts from the standard order, and can be jumped to directly.
+  COUNTER
+};
+
+// Returns false if name isn't one of legacy, xoshiro, pcg or counter
+bool parseShuffleMode(const std::string &name, ShuffleMode &mode);
+// The name parseShuffleMode accepts for mode
+const char *shuffleModeName(ShuffleMode mode);
+
+// Strategies used by a Deck to shuffle its cards
+class ShuffleEngine {
+public:
+  virtual void shuffle(DeckOrder &order) = 0;
+  // Skips over the next n shuffles without doing them. Returns false
+  // if the engine can't jump ahead.
+  virtual bool skip(uint64_t n);
+  // Starts over as if newly made with the given seed
+  virtual void reseed(unsigned seed) = 0;
+  virtual ~ShuffleEngine() = default;
+};
+
+class LegacyShuffle: public ShuffleEngine {
   std::default_random_engine rng;
-  std::vector<std::unique_ptr<Card>> cards;
-  std::map<std::string, Card*> cardMap;
+public:
+  // Amount of times that std::shuffle shuffles the deck
+  static const int PASSES = 100;
+  explicit LegacyShuffle(unsigned seed);
+  void shuffle(DeckOrder &order) override;
+  void reseed(unsigned seed) override;
+};
+
+// A single Fisher-Yates pass, with the random number generator as a policy
+template <typename Rng>
+class FisherYatesShuffle: public ShuffleEngine {
+  Rng rng;
+public:
+  explicit FisherYatesShuffle(unsigned seed) : rng{seed} {}
+  void shuffle(DeckOrder &order) override {
+    for (uint32_t i = NUM_CARDS - 1; i > 0; i--) {
+      std::swap(order[i], order[boundedRandom(rng, i + 1)]);
+    }
+  }
+  void reseed(unsigned seed) override {
+    rng = Rng{seed};
+  }
+};
+
+class CounterShuffle: public ShuffleEngine {
+  CounterRng rng;
+  uint64_t shuffles = 0;
+public:
+  explicit CounterShuffle(unsigned seed);
+  void shuffle(DeckOrder &order) override;
+  bool skip(uint64_t n) override;
+  void reseed(unsigned seed) override;
+};
+
+std::unique_ptr<ShuffleEngine> makeShuffleEngine(ShuffleMode mode, unsigned seed);
+
+class Deck {
+  std::unique_ptr<ShuffleEngine> shuffler;
+  // Cards in the standard order, which is also their index order
+  std::vector<Card> cards;
+  // The shuffled order that cards are dealt in
+  DeckOrder order;
+  // The seed actually used, after replacing DEFAULT_SEED with the time
+  unsigned seed;
+  ShuffleMode mode;
   void initializeStandardOrder(void);
   int dealtCardIndex = 0;
 public:
-  static unsigned DEFAULT_SEED;
+  static const unsigned DEFAULT_SEED = 0;
   // Seed will seed the Deck's shuffle RNG. If the seed isn't given,
   // or if the seed is DEFAULT_SEED, it's set to the current time by default.
-  Deck(unsigned seed = DEFAULT_SEED);
+  Deck(unsigned seed = DEFAULT_SEED, ShuffleMode mode = ShuffleMode::LEGACY);
   // Returns a pointer to a Card given by the string representation.
   // Returns nullptr if the card cannot be found.
-  Card *getCard(std::string rep) const;
+  Card *getCard(const std::string &rep) const;
+  Card *getCard(CardId id) const;
+  // Returns the card with the given index (see Card::getIndex)
+  Card *getCard(int index) const;
   // Deals a card from the deck to player p.
   // Throws DeckIsEmpty error if the entire deck is already delt.
   void dealCard(Player& p);
   // Returns all delt cards to the deck
   void reset();
+  // Starts over as a new Deck with this seed (and the same shuffle mode)
+  // would, without allocating
+  void reseed(unsigned seed);
   // Shuffles the deck
   void shuffle();
+  // Skips the next n shuffles, if the shuffle mode can jump ahead.
+  // Returns false (and does nothing) otherwise.
+  bool skipShuffles(uint64_t n);
+  // Deals the given order next instead of a shuffled one, until the
+  // next shuffle
+  void setOrder(const DeckOrder &newOrder);
+  const DeckOrder &getOrder() const;
+  unsigned getSeed() const;
+  ShuffleMode getShuffleMode() const;
   // Purely for testing purposes, to print the deck 
   void printDeck(void) const;
 };
@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+#include "endgame.h"
+#include "model.h"
+#include "player.h"
+#include "deck.h"
+#include "zobrist.h"
+#include "debug.h"
+#include "trace.h"
+
+// Larger than any number of points a seat can discard
+const int INFINITE_PENALTY = 1000;
+
+double EndgameStats::nodesPerSecond() const {
+  return seconds > 0 ? nodes / seconds : 0;
+}
+
+double EndgameStats::hitRate() const {
+  return probes > 0 ? static_cast<double>(hits) / probes : 0;
+}
+
+void EndgameStats::merge(const EndgameStats &other) {
+  solves += other.solves;
+  nodes += other.nodes;
+  probes += other.probes;
+  hits += other.hits;
+  seconds += other.seconds;
+}
+
+EndgameSolver::EndgameSolver(const unsigned tableBits) :
+  table(uint64_t{1} << tableBits), tableMask{(uint64_t{1} << tableBits) - 1}
+{}
+
+uint64_t EndgameSolver::hash(const SimState &state) const {
+  uint64_t h = ZOBRIST.root[root] ^ ZOBRIST.toMove[state.toMove];
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    for (CardMask m = state.hands[seat]; m; m &= m - 1) {
+      h ^= ZOBRIST.hand[seat][lowestCard(m)];
+    }
+  }
+  for (int suit = 0; suit < NUM_SUITS; suit++) {
+    h ^= pileKey(suit, state.piles[suit]);
+  }
+  return h;
+}
+
+uint64_t EndgameSolver::hashAfter(const SimState &state, uint64_t h,
+                                  const SimMove move) const {
+  const int card = moveCard(move);
+  const int seat = state.toMove;
+  h ^= ZOBRIST.hand[seat][card];
+  h ^= ZOBRIST.toMove[seat] ^ ZOBRIST.toMove[(seat + 1) % NUM_SEATS];
+  if (!isDiscard(move)) {
+    const int suit = suitOfIndex(card) - 1;
+    const PileBounds before = state.piles[suit];
+    PileBounds after = before;
+    const uint8_t rank = rankOfIndex(card);
+    if (after.empty()) after.low = after.high = rank;
+    else if (rank < after.low) after.low = rank;
+    else after.high = rank;
+    h ^= pileKey(suit, before) ^ pileKey(suit, after);
+  }
+  return h;
+}
+
+int EndgameSolver::search(const SimState &state, const uint64_t h,
+                          int alpha, int beta) {
+  stats.nodes++;
+  if (state.isRoundOver()) return 0;
+  Entry &entry = table[h & tableMask];
+  SimMove hashMove = NO_MOVE;
+  stats.probes++;
+  if (entry.bound != EMPTY && entry.key == h) {
+    stats.hits++;
+    if (entry.bound == EXACT) return entry.value;
+    if (entry.bound == LOWER && entry.value >= beta) return entry.value;
+    if (entry.bound == UPPER && entry.value <= alpha) return entry.value;
+    hashMove = entry.best;
+  }
+
+  SimMove moves[RANKS_PER_SUIT];
+  const int n = state.legalMoves(moves);
+  if (n == 0) {
+    // Only possible if hands ran out unevenly; the turn just passes
+    SimState next = state;
+    next.toMove = (next.toMove + 1) % NUM_SEATS;
+    return search(next, hash(next), alpha, beta);
+  }
+  // Try the move that was best before first, then low discards first
+  auto before = [hashMove](SimMove a, SimMove b) {
+    if ((a == hashMove) != (b == hashMove)) return a == hashMove;
+    return rankOfIndex(moveCard(a)) < rankOfIndex(moveCard(b));
+  };
+  for (int i = 1; i < n; i++) {
+    const SimMove move = moves[i];
+    int j = i;
+    for (; j > 0 && before(move, moves[j - 1]); j--) moves[j] = moves[j - 1];
+    moves[j] = move;
+  }
+
+  const bool minimizing = state.toMove == root;
+  const int alphaIn = alpha;
+  const int betaIn = beta;
+  int best = minimizing ? INFINITE_PENALTY : -INFINITE_PENALTY;
+  SimMove bestMove = moves[0];
+  for (int i = 0; i < n && alpha < beta; i++) {
+    SimState child = state;
+    child.apply(moves[i]);
+    const int gain = minimizing && isDiscard(moves[i]) ?
+      rankOfIndex(moveCard(moves[i])) : 0;
+    const int value = gain + search(child, hashAfter(state, h, moves[i]),
+                                    alpha - gain, beta - gain);
+    if (minimizing ? value < best : value > best) {
+      best = value;
+      bestMove = moves[i];
+    }
+    if (minimizing) beta = std::min(beta, best);
+    else alpha = std::max(alpha, best);
+  }
+
+  entry.key = h;
+  entry.value = best;
+  entry.best = bestMove;
+  if (best <= alphaIn) entry.bound = UPPER;
+  else if (best >= betaIn) entry.bound = LOWER;
+  else entry.bound = EXACT;
+  return best;
+}
+
+SimMove EndgameSolver::solve(const SimState &state, int &value) {
+  TraceScope trace{TraceSpan::DECISION};
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t nodesBefore = stats.nodes;
+  root = state.toMove;
+  SimMove moves[RANKS_PER_SUIT];
+  const int n = state.legalMoves(moves);
+  SimMove best = n > 0 ? moves[0] : NO_MOVE;
+  value = 0;
+  if (n > 0) {
+    const uint64_t h = hash(state);
+    value = INFINITE_PENALTY;
+    for (int i = 0; i < n; i++) {
+      SimState child = state;
+      child.apply(moves[i]);
+      const int gain = isDiscard(moves[i]) ? rankOfIndex(moveCard(moves[i])) : 0;
+      const int v = gain + search(child, hashAfter(state, h, moves[i]),
+                                  -INFINITE_PENALTY, value - gain);
+      if (v < value) {
+        value = v;
+        best = moves[i];
+      }
+    }
+  }
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  stats.seconds += elapsed.count();
+  stats.solves++;
+  Trace::add(TraceCounter::ENDGAME_NODES, stats.nodes - nodesBefore);
+  return best;
+}
+
+void EndgameSolver::clear() {
+  std::fill(table.begin(), table.end(), Entry{});
+}
+
+const EndgameStats &EndgameSolver::getStats() const {
+  return stats;
+}
+
+EndgameStrategy::EndgameStrategy(View& view, StraightsModel &model,
+                                 const EndgameConfig config,
+                                 std::unique_ptr<TurnStrategy> fallback) :
+  TurnStrategy(view, model), config{config}, fallback{std::move(fallback)}
+{}
+
+void EndgameStrategy::doTurn(ComputerPlayer &p) {
+  if (p.getHand().empty()) return;
+  const SimState state = model.getSimState(p);
+  if (state.cardsLeft() > static_cast<int>(config.cards)) {
+    fallback->doTurn(p);
+    return;
+  }
+  if (!solver) solver = std::make_unique<EndgameSolver>(config.tableBits);
+  int value;
+  const SimMove move = solver->solve(state, value);
+  #if DEBUG
+    const EndgameStats &stats = solver->getStats();
+    Debug::print("Endgame solved with " + std::to_string(value) +
+      " points to discard; nodes/sec " + std::to_string(stats.nodesPerSecond()) +
+      ", table hit rate " + std::to_string(stats.hitRate()));
+  #endif
+  Card *card = model.getCard(moveCard(move));
+  if (isDiscard(move)) {
+    discardCard(p, *card);
+  } else {
+    playCard(p, *card);
+  }
+}
+
+void EndgameStrategy::resetGame() {
+  fallback->resetGame();
+  if (solver) solver->clear();
+}
+
+void EndgameStrategy::addStats(StrategyStats &stats) const {
+  fallback->addStats(stats);
+  if (solver) stats.endgame.merge(solver->getStats());
+}
@@ -0,0 +1,67 @@
+#ifndef _H_ENDGAME
+#define _H_ENDGAME
+
+/*
+An exact solver for the end of a round. Once few enough cards are left,
+it searches every remaining play and discard with the real hands of all
+seats (perfect information), using paranoid minimax: the seat to move
+minimizes the points it will discard, and every other seat is assumed to
+play to maximize them. Alpha-beta pruning and a transposition table keyed
+on a Zobrist hash of the hands, piles and seat to move keep the search
+small.
+
+Legality comes from SimState, which follows the same bitboard rules as
+StraightsModel::isLegalPlay and getLegalPlays.
+*/
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "controller.h"
+#include "simstate.h"
+
+class EndgameSolver {
+  enum Bound: uint8_t { EMPTY, EXACT, LOWER, UPPER };
+  struct Entry {
+    uint64_t key = 0;
+    int8_t value = 0;
+    Bound bound = EMPTY;
+    SimMove best = NO_MOVE;
+  };
+  std::vector<Entry> table;
+  const uint64_t tableMask;
+  // Seat whose discards are being minimized
+  int root = 0;
+  EndgameStats stats;
+  uint64_t hash(const SimState &state) const;
+  uint64_t hashAfter(const SimState &state, uint64_t h, SimMove move) const;
+  // Points root will discard from here on, if it's within (alpha, beta)
+  int search(const SimState &state, uint64_t h, int alpha, int beta);
+public:
+  // The transposition table holds 2^tableBits entries
+  explicit EndgameSolver(unsigned tableBits);
+  // The best move for the seat to move. value is set to the points that
+  // seat will discard for the rest of the round against paranoid play.
+  SimMove solve(const SimState &state, int &value);
+  // Empties the transposition table, keeping its memory and the stats
+  void clear();
+  const EndgameStats &getStats() const;
+};
+
+// Leaves turns to another strategy until the solver takes over
+class EndgameStrategy: public TurnStrategy {
+  const EndgameConfig config;
+  std::unique_ptr<TurnStrategy> fallback;
+  // Made on the first solve, since the table is large
+  std::unique_ptr<EndgameSolver> solver;
+public:
+  EndgameStrategy(View& view, StraightsModel &model, EndgameConfig config,
+                  std::unique_ptr<TurnStrategy> fallback);
+  void doTurn(ComputerPlayer &p) override;
+  void resetGame() override;
+  // Adds the solver's totals, and the fallback's stats
+  void addStats(StrategyStats &stats) const override;
+};
+
+#endif
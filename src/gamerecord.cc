@@ -0,0 +1,461 @@
+#include <cstring>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gamerecord.h"
+#include "player.h"
+#include "debug.h"
+
+const char FILE_MAGIC[4] = {'S', 'T', 'R', 'C'};
+const char FOOTER_MAGIC[4] = {'S', 'T', 'N', 'D'};
+const uint16_t FORMAT_VERSION = 1;
+const size_t FILE_HEADER_SIZE = 8;
+const size_t FOOTER_SIZE = 16;
+const size_t GAME_HEADER_SIZE = 20;
+const unsigned CARDS_PER_HAND = NUM_CARDS / NUM_SEATS;
+
+namespace {
+  void put(std::vector<uint8_t> &out, uint64_t value, const int bytes) {
+    for (int i = 0; i < bytes; i++, value >>= 8) {
+      out.push_back(value & 0xFF);
+    }
+  }
+
+  uint64_t get(const uint8_t *in, const int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+      value = (value << 8) | in[i];
+    }
+    return value;
+  }
+
+  void writeBytes(std::ofstream &out, const std::vector<uint8_t> &bytes) {
+    out.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+  }
+}
+
+GameRecorder::GameRecorder(RecordWriter &writer) : writer{writer}
+{}
+
+void GameRecorder::beginGame(const unsigned gameSeed, const ShuffleMode mode,
+                             const std::string &playerTypes) {
+  seed = gameSeed;
+  shuffle = mode;
+  players = playerTypes;
+  players.resize(NUM_SEATS, ' ');
+  rounds = 0;
+  events.clear();
+  checkpoints.clear();
+  std::fill(totalsBefore, totalsBefore + NUM_SEATS, 0);
+  inRound = false;
+}
+
+void GameRecorder::beginRound(const DeckOrder &order) {
+  deal = order;
+  events.push_back(ROUND_START);
+  dealOffset = events.size();
+  events.insert(events.end(), order.begin(), order.end());
+  state = SimState{};
+  for (int i = 0; i < NUM_CARDS; i++) {
+    state.hands[i / CARDS_PER_HAND] |= cardBit(order[i]);
+  }
+  discards.clear();
+  turn = 0;
+  inRound = true;
+  addCheckpoint();
+}
+
+void GameRecorder::endRound() {
+  events.push_back(ROUND_END);
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    events.push_back(state.penalties[seat]);
+    totalsBefore[seat] += state.penalties[seat];
+  }
+  rounds++;
+  inRound = false;
+}
+
+void GameRecorder::endGame() {
+  std::vector<uint8_t> game;
+  game.reserve(GAME_HEADER_SIZE + events.size() + checkpoints.size());
+  put(game, seed, 4);
+  put(game, static_cast<uint8_t>(shuffle), 1);
+  game.insert(game.end(), players.begin(), players.begin() + NUM_SEATS);
+  put(game, 0, 1);
+  put(game, rounds, 2);
+  put(game, events.size(), 4);
+  put(game, checkpoints.size() / CHECKPOINT_SIZE, 4);
+  game.insert(game.end(), events.begin(), events.end());
+  game.insert(game.end(), checkpoints.begin(), checkpoints.end());
+  writer.append(game);
+}
+
+void GameRecorder::addCheckpoint() {
+  const size_t start = checkpoints.size();
+  put(checkpoints, rounds, 2);
+  put(checkpoints, turn, 1);
+  put(checkpoints, discards.size(), 1);
+  put(checkpoints, events.size(), 4);
+  put(checkpoints, dealOffset, 4);
+  for (const CardMask hand : state.hands) {
+    put(checkpoints, hand, 8);
+  }
+  for (const PileBounds pile : state.piles) {
+    put(checkpoints, pile.low, 1);
+    put(checkpoints, pile.high, 1);
+  }
+  for (const int total : totalsBefore) {
+    put(checkpoints, static_cast<uint16_t>(total), 2);
+  }
+  checkpoints.insert(checkpoints.end(), discards.begin(), discards.end());
+  checkpoints.resize(start + CHECKPOINT_SIZE, 0);
+}
+
+void GameRecorder::addMove(const int seat, const SimMove move) {
+  if (!inRound) return;
+  if (turn > 0 && turn % CHECKPOINT_INTERVAL == 0) addCheckpoint();
+  events.push_back(move);
+  state.toMove = seat;
+  state.apply(move);
+  if (isDiscard(move)) discards.push_back((seat << 6) | moveCard(move));
+  turn++;
+}
+
+void GameRecorder::cardPlayed(const int seat, const CardId card) {
+  addMove(seat, playMove(card.index()));
+}
+
+void GameRecorder::cardDiscarded(const int seat, const CardId card) {
+  addMove(seat, discardMove(card.index()));
+}
+
+void GameRecorder::moveUndone() {
+  if (!inRound || turn == 0) return;
+  events.pop_back();
+  turn--;
+  // Drop a checkpoint taken just before the move, and rebuild the
+  // round from its deal
+  if (turn > 0 && turn % CHECKPOINT_INTERVAL == 0) {
+    checkpoints.resize(checkpoints.size() - CHECKPOINT_SIZE);
+  }
+  state = SimState{};
+  for (int i = 0; i < NUM_CARDS; i++) {
+    state.hands[i / CARDS_PER_HAND] |= cardBit(deal[i]);
+  }
+  discards.clear();
+  for (size_t i = dealOffset + NUM_CARDS; i < events.size(); i++) {
+    const SimMove move = events[i];
+    int seat = 0;
+    while (!(state.hands[seat] & cardBit(moveCard(move)))) seat++;
+    state.toMove = seat;
+    state.apply(move);
+    if (isDiscard(move)) discards.push_back((seat << 6) | moveCard(move));
+  }
+}
+
+RecordWriter::RecordWriter(const std::string &path) :
+  out{path, std::ios::binary | std::ios::trunc}
+{
+  if (!out) throw RecordIOError{};
+  std::vector<uint8_t> header{FILE_MAGIC, FILE_MAGIC + 4};
+  put(header, FORMAT_VERSION, 2);
+  put(header, 0, 2);
+  writeBytes(out, header);
+  offset = header.size();
+}
+
+void RecordWriter::append(const std::vector<uint8_t> &game) {
+  gameOffsets.push_back(offset);
+  writeBytes(out, game);
+  offset += game.size();
+}
+
+void RecordWriter::close() {
+  if (closed) return;
+  closed = true;
+  std::vector<uint8_t> tail;
+  for (const uint64_t gameOffset : gameOffsets) {
+    put(tail, gameOffset, 8);
+  }
+  put(tail, offset, 8);
+  put(tail, gameOffsets.size(), 4);
+  tail.insert(tail.end(), FOOTER_MAGIC, FOOTER_MAGIC + 4);
+  writeBytes(out, tail);
+  out.close();
+}
+
+RecordWriter::~RecordWriter() {
+  close();
+}
+
+Checkpoint GameRecord::getCheckpoint(const size_t i) const {
+  const uint8_t *in = checkpointData + i * CHECKPOINT_SIZE;
+  Checkpoint c;
+  c.round = get(in, 2);
+  c.turn = in[2];
+  const unsigned discardCount = std::min<unsigned>(in[3], NUM_CARDS);
+  c.eventOffset = get(in + 4, 4);
+  c.dealOffset = get(in + 8, 4);
+  in += 12;
+  for (CardMask &hand : c.hands) {
+    hand = get(in, 8);
+    in += 8;
+  }
+  for (PileBounds &pile : c.piles) {
+    pile.low = in[0];
+    pile.high = in[1];
+    in += 2;
+  }
+  for (int &total : c.totalsBefore) {
+    total = static_cast<int16_t>(get(in, 2));
+    in += 2;
+  }
+  c.discards.assign(in, in + discardCount);
+  if (c.eventOffset > eventBytes || c.dealOffset + NUM_CARDS > eventBytes) {
+    throw InvalidRecord{};
+  }
+  return c;
+}
+
+std::vector<std::array<int, NUM_SEATS>> GameRecord::getRoundScores() const {
+  std::vector<std::array<int, NUM_SEATS>> scores;
+  size_t i = 0;
+  while (i < eventBytes) {
+    if (events[i] == ROUND_START) {
+      i += 1 + NUM_CARDS;
+    } else if (events[i] == ROUND_END) {
+      if (i + NUM_SEATS >= eventBytes) throw InvalidRecord{};
+      std::array<int, NUM_SEATS> round;
+      for (int seat = 0; seat < NUM_SEATS; seat++) {
+        round[seat] = events[i + 1 + seat];
+      }
+      scores.push_back(round);
+      i += 1 + NUM_SEATS;
+    } else {
+      i++;
+    }
+  }
+  return scores;
+}
+
+RecordFile::RecordFile(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw RecordIOError{};
+  struct stat info;
+  if (fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw RecordIOError{};
+  }
+  size = info.st_size;
+  if (size < FILE_HEADER_SIZE + FOOTER_SIZE) {
+    ::close(fd);
+    throw InvalidRecord{};
+  }
+  void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (mapped == MAP_FAILED) throw RecordIOError{};
+  data = static_cast<const uint8_t *>(mapped);
+
+  const uint8_t *footer = data + size - FOOTER_SIZE;
+  const uint64_t indexOffset = get(footer, 8);
+  const uint64_t games = get(footer + 8, 4);
+  if (std::memcmp(data, FILE_MAGIC, 4) != 0 ||
+      get(data + 4, 2) != FORMAT_VERSION ||
+      std::memcmp(footer + 12, FOOTER_MAGIC, 4) != 0 ||
+      indexOffset + games * 8 != size - FOOTER_SIZE) {
+    munmap(const_cast<uint8_t *>(data), size);
+    throw InvalidRecord{};
+  }
+  for (uint64_t i = 0; i < games; i++) {
+    gameOffsets.push_back(get(data + indexOffset + i * 8, 8));
+  }
+}
+
+RecordFile::~RecordFile() {
+  munmap(const_cast<uint8_t *>(data), size);
+}
+
+size_t RecordFile::getGameCount() const {
+  return gameOffsets.size();
+}
+
+GameRecord RecordFile::getGame(const size_t i) const {
+  const uint64_t start = gameOffsets.at(i);
+  if (start + GAME_HEADER_SIZE > size) throw InvalidRecord{};
+  const uint8_t *in = data + start;
+  GameRecord game;
+  game.seed = get(in, 4);
+  game.shuffle = static_cast<ShuffleMode>(in[4]);
+  game.players.assign(reinterpret_cast<const char *>(in + 5), NUM_SEATS);
+  game.rounds = get(in + 10, 2);
+  game.eventBytes = get(in + 12, 4);
+  game.checkpoints = get(in + 16, 4);
+  game.events = in + GAME_HEADER_SIZE;
+  game.checkpointData = game.events + game.eventBytes;
+  if (start + GAME_HEADER_SIZE + game.eventBytes +
+      game.checkpoints * CHECKPOINT_SIZE > size) {
+    throw InvalidRecord{};
+  }
+  return game;
+}
+
+GameReplay::GameReplay(const GameRecord &record) :
+  record{record}, model{record.seed, record.shuffle}
+{
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    const std::string prefix = record.players[seat] == 'h' ?
+      "Player" : "Computer";
+    model.addPlayer(std::make_unique<HumanPlayer>(
+      prefix + std::to_string(seat + 1)));
+  }
+}
+
+void GameReplay::startRound(const uint8_t *order) {
+  DeckOrder deal;
+  std::copy(order, order + NUM_CARDS, deal.begin());
+  model.resetRound();
+  model.dealHands(deal);
+  round++;
+  turn = 0;
+}
+
+bool GameReplay::step() {
+  while (position < record.eventBytes) {
+    const uint8_t event = record.events[position];
+    if (event == ROUND_START) {
+      if (position + 1 + NUM_CARDS > record.eventBytes) throw InvalidRecord{};
+      startRound(record.events + position + 1);
+      position += 1 + NUM_CARDS;
+    } else if (event == ROUND_END) {
+      position += 1 + NUM_SEATS;
+    } else {
+      const int index = moveCard(event);
+      if (index >= NUM_CARDS) throw InvalidRecord{};
+      Card &card = *model.getCard(index);
+      Player *p = model.whoHasCard(card);
+      if (!p) throw InvalidRecord{};
+      if (isDiscard(event)) model.discardCard(*p, card);
+      else model.playCard(*p, card);
+      position++;
+      turn++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void GameReplay::seek(const unsigned targetRound, const unsigned targetTurn) {
+  // Find the last checkpoint at or before the target
+  size_t lo = 0, hi = record.checkpoints;
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    const Checkpoint c = record.getCheckpoint(mid);
+    if (c.round < targetRound ||
+        (c.round == targetRound && c.turn <= targetTurn)) lo = mid + 1;
+    else hi = mid;
+  }
+  if (lo == 0) throw PositionNotInRecord{};
+  const Checkpoint c = record.getCheckpoint(lo - 1);
+  if (c.round != targetRound) throw PositionNotInRecord{};
+
+  DeckOrder deal;
+  std::copy(record.events + c.dealOffset,
+            record.events + c.dealOffset + NUM_CARDS, deal.begin());
+  std::vector<std::pair<int, CardId>> discards;
+  for (const uint8_t discard : c.discards) {
+    discards.emplace_back(discard >> 6, CardId{discard & 0x3F});
+  }
+  model.loadRound(deal, c.hands, discards, c.piles, c.totalsBefore);
+  round = c.round;
+  turn = c.turn;
+  position = c.eventOffset;
+  while (turn < targetTurn) {
+    if (position >= record.eventBytes ||
+        record.events[position] == ROUND_END ||
+        record.events[position] == ROUND_START) {
+      throw PositionNotInRecord{};
+    }
+    step();
+  }
+}
+
+int GameReplay::getRound() const {
+  return round;
+}
+
+unsigned GameReplay::getTurn() const {
+  return turn;
+}
+
+StraightsModel &GameReplay::getModel() {
+  return model;
+}
+
+namespace {
+  void printCards(std::ostream &out, const std::deque<Card*> &cards) {
+    for (const Card *card : cards) out << " " << *card;
+    out << std::endl;
+  }
+
+  void printCards(std::ostream &out, const std::vector<Card*> &cards) {
+    for (const Card *card : cards) out << " " << *card;
+    out << std::endl;
+  }
+
+  void printPosition(std::ostream &out, GameReplay &replay) {
+    StraightsModel &model = replay.getModel();
+    out << "round " << replay.getRound() + 1 << ", turn "
+        << replay.getTurn() << std::endl;
+    out << "Clubs:";
+    printCards(out, model.getClubsPile());
+    out << "Diamonds:";
+    printCards(out, model.getDiamondsPile());
+    out << "Hearts:";
+    printCards(out, model.getHeartsPile());
+    out << "Spades:";
+    printCards(out, model.getSpadesPile());
+    model.forEachPlayer([&out](Player &p) {
+      out << p.getName() << " (" << p.getTotalScore() << " points)"
+          << std::endl << "  hand:";
+      printCards(out, p.getHand());
+      out << "  discards:";
+      printCards(out, p.getDiscards());
+    });
+  }
+}
+
+void runReplay(const ReplayConfig &config, std::ostream &out) {
+  const RecordFile file{config.path};
+  if (config.round >= 0) {
+    if (config.game >= file.getGameCount()) throw PositionNotInRecord{};
+    const GameRecord game = file.getGame(config.game);
+    GameReplay replay{game};
+    replay.seek(config.round, config.turn);
+    printPosition(out, replay);
+    return;
+  }
+  out << "games: " << file.getGameCount() << std::endl;
+  for (size_t i = 0; i < file.getGameCount(); i++) {
+    const GameRecord game = file.getGame(i);
+    out << "game " << i << ": seed " << game.seed << " shuffle "
+        << shuffleModeName(game.shuffle) << " players " << game.players
+        << " rounds " << game.rounds << std::endl;
+    int totals[NUM_SEATS] = {0, 0, 0, 0};
+    for (const auto &round : game.getRoundScores()) {
+      out << "  round:";
+      for (int seat = 0; seat < NUM_SEATS; seat++) {
+        totals[seat] += round[seat];
+        out << " " << round[seat];
+      }
+      out << std::endl;
+    }
+    out << "  totals:";
+    for (const int total : totals) out << " " << total;
+    out << std::endl;
+  }
+}
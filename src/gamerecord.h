@@ -0,0 +1,196 @@
+#ifndef _H_GAMERECORD
+#define _H_GAMERECORD
+
+/*
+A compact binary record of complete games, and a reader that maps record
+files into memory and replays them through a StraightsModel.
+
+All numbers are little-endian. A file is laid out as
+
+  header   "STRC", uint16 version, uint16 reserved
+  games    one after another (see below)
+  index    uint64 file offset of each game
+  footer   uint64 offset of the index, uint32 number of games, "STND"
+
+and each game as
+
+  uint32 seed, uint8 shuffle mode, char player types[4], uint8 reserved,
+  uint16 rounds, uint32 event bytes, uint32 checkpoints
+  events       one byte per play or discard (a SimMove), with each round
+               opened by ROUND_START and the 52 card indexes of its deal,
+               and closed by ROUND_END and each seat's score that round
+  checkpoints  CHECKPOINT_SIZE bytes each, in the order they were taken
+
+A checkpoint is taken at the start of every round and every
+CHECKPOINT_INTERVAL turns after that. It holds everything needed to set up
+the model at that turn: the hands, piles, discards so far this round and
+the total scores before the round. Seeking loads the checkpoint before the
+target and replays at most CHECKPOINT_INTERVAL - 1 moves from there.
+*/
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <array>
+#include <fstream>
+#include <cstdint>
+
+#include "simstate.h"
+#include "deck.h"
+#include "model.h"
+
+const uint8_t ROUND_START = 0xF0;
+const uint8_t ROUND_END = 0xF1;
+const unsigned CHECKPOINT_INTERVAL = 16;
+const size_t CHECKPOINT_SIZE = 112;
+
+// Accumulates a game in memory, and appends it to a RecordWriter
+// when it ends
+class RecordWriter;
+class GameRecorder: public GameObserver {
+  RecordWriter &writer;
+  uint32_t seed = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  std::string players;
+  unsigned rounds = 0;
+  std::vector<uint8_t> events;
+  std::vector<uint8_t> checkpoints;
+  // The round being recorded
+  DeckOrder deal;
+  size_t dealOffset = 0;
+  SimState state;
+  // Discards of this round in order, each (seat << 6) | card
+  std::vector<uint8_t> discards;
+  unsigned turn = 0;
+  int totalsBefore[NUM_SEATS] = {0, 0, 0, 0};
+  bool inRound = false;
+  void addCheckpoint();
+  void addMove(int seat, SimMove move);
+public:
+  explicit GameRecorder(RecordWriter &writer);
+  void beginGame(unsigned gameSeed, ShuffleMode mode,
+                 const std::string &playerTypes);
+  void beginRound(const DeckOrder &order);
+  void endRound();
+  // Appends the game to the writer. Unfinished rounds are kept.
+  void endGame();
+  void cardPlayed(int seat, CardId card) override;
+  void cardDiscarded(int seat, CardId card) override;
+  void moveUndone() override;
+};
+
+// Writes games to a record file. The file is only complete once close
+// has been called (or the writer destroyed).
+class RecordWriter {
+  std::ofstream out;
+  std::vector<uint64_t> gameOffsets;
+  uint64_t offset = 0;
+  bool closed = false;
+public:
+  // Throws RecordIOError if the file can't be created
+  explicit RecordWriter(const std::string &path);
+  void append(const std::vector<uint8_t> &game);
+  void close();
+  ~RecordWriter();
+};
+
+// A position saved in a game record
+struct Checkpoint {
+  unsigned round = 0;
+  unsigned turn = 0;
+  // Offsets into the game's events of the next event, and of the deal
+  size_t eventOffset = 0;
+  size_t dealOffset = 0;
+  CardMask hands[NUM_SEATS] = {0, 0, 0, 0};
+  PileBounds piles[NUM_SUITS];
+  int totalsBefore[NUM_SEATS] = {0, 0, 0, 0};
+  // (seat << 6) | card of each discard this round, in order
+  std::vector<uint8_t> discards;
+};
+
+// One game in a mapped record file. Only valid while the file is.
+struct GameRecord {
+  unsigned seed = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  std::string players;
+  unsigned rounds = 0;
+  const uint8_t *events = nullptr;
+  size_t eventBytes = 0;
+  const uint8_t *checkpointData = nullptr;
+  size_t checkpoints = 0;
+  Checkpoint getCheckpoint(size_t i) const;
+  // Each finished round's scores, read from the events
+  std::vector<std::array<int, NUM_SEATS>> getRoundScores() const;
+};
+
+// A record file mapped into memory
+class RecordFile {
+  const uint8_t *data = nullptr;
+  size_t size = 0;
+  std::vector<uint64_t> gameOffsets;
+public:
+  // Throws RecordIOError if the file can't be read, and InvalidRecord
+  // if it isn't a complete record file
+  explicit RecordFile(const std::string &path);
+  RecordFile(const RecordFile &) = delete;
+  RecordFile &operator=(const RecordFile &) = delete;
+  ~RecordFile();
+  size_t getGameCount() const;
+  // Throws InvalidRecord if the game's data doesn't fit in the file
+  GameRecord getGame(size_t i) const;
+};
+
+// Replays a recorded game through a model with a placeholder player in
+// each seat
+class GameReplay {
+  const GameRecord &record;
+  StraightsModel model;
+  size_t position = 0;
+  // Round being replayed (-1 before the first deal), and moves made in it
+  int round = -1;
+  unsigned turn = 0;
+  void startRound(const uint8_t *order);
+public:
+  explicit GameReplay(const GameRecord &record);
+  // Makes the next play or discard, dealing the next round first if the
+  // current one is over. Returns false at the end of the record.
+  bool step();
+  // Moves to the position after the given number of turns in a round,
+  // counting both from 0. Throws PositionNotInRecord if the record
+  // doesn't reach it.
+  void seek(unsigned targetRound, unsigned targetTurn);
+  int getRound() const;
+  unsigned getTurn() const;
+  StraightsModel &getModel();
+};
+
+struct ReplayConfig {
+  std::string path;
+  unsigned game = 0;
+  // If negative, every game is summarized instead of showing a position
+  int round = -1;
+  unsigned turn = 0;
+};
+
+// Summarizes the games in a record file, or shows the board and hands
+// at one position in one of them
+void runReplay(const ReplayConfig &config, std::ostream &out);
+
+// Exceptions
+struct InvalidRecord: public std::exception {
+  const char* what() {
+    return "File is not a valid game record.";
+  }
+};
+struct RecordIOError: public std::exception {
+  const char* what() {
+    return "Game record file could not be opened.";
+  }
+};
+struct PositionNotInRecord: public std::exception {
+  const char* what() {
+    return "The game record does not reach that position.";
+  }
+};
+
+#endif
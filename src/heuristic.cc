@@ -0,0 +1,132 @@
+#include "heuristic.h"
+#include "model.h"
+#include "player.h"
+
+namespace {
+  // How much each feature of a suit is worth, tuned against SimpleStrategy
+  const int BLOCKING_WEIGHT = 8;
+  const int EXPOSURE_WEIGHT = 4;
+  const int DISCARD_WEIGHT = 32;
+  const int RUN_WEIGHT = 1;
+
+  const unsigned SUIT_BITS = (1u << RANKS_PER_SUIT) - 1;
+
+  bool holds(const unsigned pattern, const int rank) {
+    return pattern & (1u << (rank - 1));
+  }
+
+  // Adds up one side of a pile, walking outwards from the next rank to
+  // be played (first) by step. shut is set if this player holds a card
+  // between that rank and the pile, and gaps counts the other seats'
+  // cards in the same place.
+  void addSide(const unsigned pattern, int rank, const int step, bool shut,
+               int gaps, SuitFeatures &f) {
+    if (gaps == 0) {
+      for (; rank >= 1 && rank <= RANKS_PER_SUIT && holds(pattern, rank);
+           rank += step) {
+        f.run++;
+        shut = true;
+      }
+    }
+    for (; rank >= 1 && rank <= RANKS_PER_SUIT; rank += step) {
+      if (holds(pattern, rank)) {
+        f.exposure += rank * (gaps + (shut ? 1 : 0));
+      } else {
+        gaps++;
+        if (shut) f.blocking++;
+      }
+    }
+  }
+
+  int value(const SuitFeatures &f) {
+    return BLOCKING_WEIGHT * f.blocking - EXPOSURE_WEIGHT * f.exposure;
+  }
+}
+
+int SuitTable::pileState(const PileBounds pile) {
+  if (pile.empty()) return 0;
+  return 1 + (pile.low - 1) * (RANKS_PER_SUIT - STARTING_RANK + 1) +
+         (pile.high - STARTING_RANK);
+}
+
+SuitFeatures SuitTable::table[PATTERNS * PILE_STATES];
+
+bool SuitTable::build() {
+  for (unsigned pattern = 0; pattern < PATTERNS; pattern++) {
+    SuitFeatures *entries = &table[pattern * PILE_STATES];
+    // Empty pile: the seven opens both sides
+    SuitFeatures &empty = entries[0];
+    const bool seven = holds(pattern, STARTING_RANK);
+    if (seven) empty.run++;
+    addSide(pattern, STARTING_RANK - 1, -1, seven, seven ? 0 : 1, empty);
+    addSide(pattern, STARTING_RANK + 1, 1, seven, seven ? 0 : 1, empty);
+    for (int low = 1; low <= STARTING_RANK; low++) {
+      for (int high = STARTING_RANK; high <= RANKS_PER_SUIT; high++) {
+        PileBounds pile;
+        pile.low = low;
+        pile.high = high;
+        SuitFeatures &f = entries[pileState(pile)];
+        addSide(pattern, low - 1, -1, false, 0, f);
+        addSide(pattern, high + 1, 1, false, 0, f);
+      }
+    }
+  }
+  return true;
+}
+
+const SuitFeatures &SuitTable::get(const unsigned pattern, const int pileState) {
+  static const bool built = build();
+  (void)built;
+  return table[pattern * PILE_STATES + pileState];
+}
+
+SimMove chooseHeuristicMove(const CardMask hand, const PileBounds piles[NUM_SUITS]) {
+  const CardMask legal = hand & playableMask(piles);
+  const bool discarding = legal == 0;
+  SimMove best = NO_MOVE;
+  int bestScore = 0;
+  for (CardMask moves = discarding ? hand : legal; moves; moves &= moves - 1) {
+    const int card = lowestCard(moves);
+    const int suit = suitOfIndex(card);
+    const int rank = rankOfIndex(card);
+    const unsigned pattern = (hand >> cardIndex(suit, 1)) & SUIT_BITS;
+    const unsigned after = pattern & ~(1u << (rank - 1));
+    PileBounds pile = piles[suit - 1];
+    const int before = value(SuitTable::get(pattern, SuitTable::pileState(pile)));
+    int score;
+    if (discarding) {
+      score = value(SuitTable::get(after, SuitTable::pileState(pile))) -
+              before - DISCARD_WEIGHT * rank;
+    } else {
+      if (pile.empty()) pile.low = pile.high = rank;
+      else if (rank < pile.low) pile.low = rank;
+      else pile.high = rank;
+      const SuitFeatures &next = SuitTable::get(after, SuitTable::pileState(pile));
+      score = value(next) - before - RUN_WEIGHT * next.run;
+    }
+    if (best == NO_MOVE || score > bestScore) {
+      best = discarding ? discardMove(card) : playMove(card);
+      bestScore = score;
+    }
+  }
+  return best;
+}
+
+HeuristicStrategy::HeuristicStrategy(View& view, StraightsModel &model) :
+  TurnStrategy{view, model}
+{
+  // Builds the table now, rather than during a turn
+  SuitTable::get(0, 0);
+}
+
+void HeuristicStrategy::doTurn(ComputerPlayer &p) {
+  if (p.getHand().empty()) return;
+  const SimState state = model.getSimState(p);
+  const SimMove move = chooseHeuristicMove(state.hands[state.toMove], state.piles);
+  Card *card = model.getCard(moveCard(move));
+  if (isDiscard(move)) {
+    discardCard(p, *card);
+  } else {
+    playCard(p, *card);
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef _H_HEURISTIC
+#define _H_HEURISTIC
+
+/*
+A rule-based computer player ('t') that is much stronger than
+SimpleStrategy, yet decides with a handful of table lookups.
+
+A suit only matters to a player through the ranks they hold in it (a
+13-bit pattern) and the state of its pile (empty, or the ranks from low
+to high). SuitTable holds features of every pattern on every pile state,
+built once at startup:
+
+- blocking: cards the other seats hold that can't be played until this
+  player opens the way, as they hold the card next to the pile.
+- exposure: how likely this player is to end up discarding their cards
+  that only others can open the way to. Each such card counts its rank
+  times the other seats' cards in the way, plus one if this player is
+  holding the way shut themselves.
+- run: cards this player could play one after another from the pile
+  without anyone else's help.
+
+A move changes a single suit, so it's scored by looking up that suit
+before and after. Plays keep as many others blocked, and as few of
+this player's own points exposed, as they can, and break ties by playing
+from the shorter run, keeping longer ones to fall back on. Discards also
+pay the points of the card.
+*/
+
+#include <cstdint>
+
+#include "controller.h"
+#include "simstate.h"
+
+struct SuitFeatures {
+  uint8_t blocking = 0;
+  uint8_t run = 0;
+  uint16_t exposure = 0;
+};
+
+// Features of every suit holding on every pile state
+class SuitTable {
+  // Is a static class
+  SuitTable() {};
+public:
+  // Holdings, as bit (rank - 1) set for each rank held
+  static const unsigned PATTERNS = 1 << RANKS_PER_SUIT;
+  // An empty pile, and each low rank 1-7 with each high rank 7-13
+  static const int PILE_STATES = 1 + STARTING_RANK * (RANKS_PER_SUIT - STARTING_RANK + 1);
+private:
+  // Static storage rather than the heap, since every game shares it
+  static SuitFeatures table[PATTERNS * PILE_STATES];
+  static bool build();
+public:
+  static int pileState(PileBounds pile);
+  // The table is built by the first call
+  static const SuitFeatures &get(unsigned pattern, int pileState);
+};
+
+// The move the heuristic makes with the given hand and piles (indexed
+// by suit - 1). The hand must not be empty.
+SimMove chooseHeuristicMove(CardMask hand, const PileBounds piles[NUM_SUITS]);
+
+class HeuristicStrategy: public TurnStrategy {
+public:
+  HeuristicStrategy(View& view, StraightsModel &model);
+  void doTurn(ComputerPlayer &p) override;
+};
+
+#endif
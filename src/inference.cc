@@ -0,0 +1,219 @@
+#include "inference.h"
+#include "model.h"
+
+namespace {
+  // n choose k, as a double since counts of deals overflow 64 bits
+  double choose(const int n, const int k) {
+    if (k < 0 || k > n) return 0;
+    double ways = 1;
+    for (int i = 1; i <= k; i++) {
+      ways = ways * (n - k + i) / i;
+    }
+    return ways;
+  }
+}
+
+void HandInference::startRound(const int seat, const CardMask hand) {
+  this->seat = seat;
+  this->hand = hand;
+  turn = 0;
+  ownDiscards = 0;
+  unseen = ALL_CARDS & ~hand;
+  for (PileBounds &pile : piles) {
+    pile = PileBounds{};
+  }
+  for (uint8_t &from : playableFrom) {
+    from = NEVER;
+  }
+  for (CardMask m = playableMask(piles); m; m &= m - 1) {
+    playableFrom[lowestCard(m)] = 0;
+  }
+  for (int s = 0; s < NUM_SEATS; s++) {
+    handSizes[s] = RANKS_PER_SUIT;
+    lastDiscard[s] = -1;
+  }
+  discardCount = 0;
+  update();
+}
+
+void HandInference::played(const int mover, const int card) {
+  const CardMask bit = cardBit(card);
+  if (mover == seat) hand &= ~bit;
+  else handSizes[mover]--;
+  unseen &= ~bit;
+  const CardMask before = playableMask(piles);
+  PileBounds &pile = piles[suitOfIndex(card) - 1];
+  const uint8_t rank = rankOfIndex(card);
+  if (pile.empty()) pile.low = pile.high = rank;
+  else if (rank < pile.low) pile.low = rank;
+  else pile.high = rank;
+  turn++;
+  // The cards this play opened the way to are playable from the next turn
+  for (CardMask m = playableMask(piles) & ~before; m; m &= m - 1) {
+    playableFrom[lowestCard(m)] = turn;
+  }
+  update();
+}
+
+void HandInference::discarded(const int mover, const int card) {
+  if (mover == seat) {
+    hand &= ~cardBit(card);
+    ownDiscards |= cardBit(card);
+  } else {
+    handSizes[mover]--;
+    lastDiscard[mover] = turn;
+    Slot &slot = discards[discardCount++];
+    slot.seat = mover;
+    slot.after = turn;
+    slot.size = 1;
+    slot.discard = true;
+  }
+  turn++;
+  update();
+}
+
+void HandInference::update() {
+  slotCount = 0;
+  for (int s = 0; s < NUM_SEATS; s++) {
+    if (s == seat) continue;
+    Slot &slot = slots[slotCount++];
+    slot.seat = s;
+    slot.after = lastDiscard[s];
+    slot.size = handSizes[s];
+    slot.discard = false;
+  }
+  for (int i = 0; i < discardCount; i++) {
+    slots[slotCount++] = discards[i];
+  }
+  // Insertion sort, latest turn first; the slots are nearly in order
+  for (int i = 1; i < slotCount; i++) {
+    const Slot slot = slots[i];
+    int j = i;
+    for (; j > 0 && slots[j - 1].after < slot.after; j--) {
+      slots[j] = slots[j - 1];
+    }
+    slots[j] = slot;
+  }
+  for (int i = 0; i < slotCount; i++) {
+    if (!slots[i].discard) handSlot[slots[i].seat] = i;
+  }
+
+  // fitting[t + 1] counts the unseen cards playable from turn t + 1 on
+  for (int &f : fitting) {
+    f = 0;
+  }
+  for (CardMask m = unseen; m; m &= m - 1) {
+    fitting[playableFrom[lowestCard(m)]]++;
+  }
+  for (int t = NUM_CARDS; t >= 0; t--) {
+    fitting[t] += fitting[t + 1];
+  }
+  deals = count(-1, -1);
+}
+
+double HandInference::count(const int kind, const int slot) const {
+  double ways = 1;
+  int used = 0;
+  for (int i = 0; i < slotCount && ways > 0; i++) {
+    const Slot &s = slots[i];
+    const int size = s.size - (i == slot ? 1 : 0);
+    const int free = fitting[s.after + 1] - (kind > s.after ? 1 : 0) - used;
+    ways *= choose(free, size);
+    used += size;
+  }
+  return ways;
+}
+
+double HandInference::chance(const int kind, const int slot) const {
+  const Slot &s = slots[slot];
+  if (deals == 0 || s.size == 0 || kind <= s.after) return 0;
+  return count(kind, slot) / deals;
+}
+
+void HandInference::sync(const StraightsModel &model, const int seat) {
+  const DeckOrder &order = model.getDealOrder();
+  const int made = model.getMoveCount();
+  bool fresh = seat != this->seat || made < turn || order != dealtOrder;
+  for (int i = 0; i < turn && !fresh; i++) {
+    int mover;
+    fresh = model.getMove(i, mover) != moves[i] || mover != movers[i];
+  }
+  if (fresh) {
+    dealtOrder = order;
+    CardMask dealt = 0;
+    for (int i = 0; i < RANKS_PER_SUIT; i++) {
+      dealt |= cardBit(order[seat * RANKS_PER_SUIT + i]);
+    }
+    startRound(seat, dealt);
+  }
+  while (turn < made) {
+    int mover;
+    const SimMove move = model.getMove(turn, mover);
+    moves[turn] = move;
+    movers[turn] = mover;
+    if (isDiscard(move)) discarded(mover, moveCard(move));
+    else played(mover, moveCard(move));
+  }
+}
+
+CardMask HandInference::getUnseen() const {
+  return unseen;
+}
+
+double HandInference::countDeals() const {
+  return deals;
+}
+
+double HandInference::holdProbability(const int holder, const int card) const {
+  if (holder == seat) return hand & cardBit(card) ? 1 : 0;
+  if (!(unseen & cardBit(card))) return 0;
+  return chance(playableFrom[card], handSlot[holder]);
+}
+
+double HandInference::discardProbability(const int holder, const int card) const {
+  if (holder == seat) return ownDiscards & cardBit(card) ? 1 : 0;
+  if (!(unseen & cardBit(card))) return 0;
+  double sum = 0;
+  for (int i = 0; i < slotCount; i++) {
+    if (slots[i].discard && slots[i].seat == holder) {
+      sum += chance(playableFrom[card], i);
+    }
+  }
+  return sum;
+}
+
+CardMask HandInference::possibleHand(const int holder) const {
+  if (holder == seat) return hand;
+  if (handSizes[holder] == 0) return 0;
+  CardMask possible = 0;
+  for (CardMask m = unseen; m; m &= m - 1) {
+    const int card = lowestCard(m);
+    if (playableFrom[card] > lastDiscard[holder]) possible |= cardBit(card);
+  }
+  return possible;
+}
+
+void HandInference::handProbabilities(double chances[NUM_SEATS][NUM_CARDS]) const {
+  // Worked out once for each turn the unseen cards became playable on
+  double byKind[NUM_CARDS + 1][NUM_SEATS];
+  bool done[NUM_CARDS + 1] = {};
+  for (int card = 0; card < NUM_CARDS; card++) {
+    const CardMask bit = cardBit(card);
+    if (!(unseen & bit)) {
+      for (int s = 0; s < NUM_SEATS; s++) {
+        chances[s][card] = s == seat && (hand & bit) ? 1 : 0;
+      }
+      continue;
+    }
+    const int kind = playableFrom[card];
+    if (!done[kind]) {
+      for (int s = 0; s < NUM_SEATS; s++) {
+        byKind[kind][s] = s == seat ? 0 : chance(kind, handSlot[s]);
+      }
+      done[kind] = true;
+    }
+    for (int s = 0; s < NUM_SEATS; s++) {
+      chances[s][card] = byKind[kind][s];
+    }
+  }
+}
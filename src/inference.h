@@ -0,0 +1,118 @@
+#ifndef _H_INFERENCE
+#define _H_INFERENCE
+
+/*
+Exact inference of where the cards a seat can't see are, from everything
+the table has seen: the piles, how many cards each seat holds, and when
+each seat discarded.
+
+A seat only discards when it has nothing to play, so at that moment it
+held none of the playable cards. A card that isn't on a pile stays
+playable from the turn it became playable until it's played. So a hidden
+card that became playable on turn t wasn't held by a seat that discarded
+on turn t or later: it can't be in that seat's hand now, nor be any of the
+cards it discarded from then on.
+
+Each place a hidden card can be is a slot: an opponent's hand, or one of
+their discards. A slot only takes the cards that became playable after a
+certain turn (the seat's latest discard for a hand, the discard's own turn
+for a discard), so the cards each slot can take are nested. The deals
+consistent with everything seen are then counted exactly by filling the
+slots from the one that can take the fewest cards to the one that can
+take the most, each choosing among the cards it can take less those
+already used. The chance that a card is in a slot is the count with the
+card put there first, over the total. Cards that became playable on the
+same turn are interchangeable, so they share their chances.
+
+Each move is taken in constant time, and each query is a few counts over
+at most 42 slots. Nothing is allocated.
+*/
+
+#include <cstdint>
+
+#include "bitboard.h"
+#include "deck.h"
+#include "simstate.h"
+
+class StraightsModel;
+
+class HandInference {
+  // A hand, or one discard, of a seat other than the one inferring
+  struct Slot {
+    int8_t seat;
+    // Takes only cards that became playable after this turn (-1 for any)
+    int8_t after;
+    uint8_t size;
+    bool discard;
+  };
+  // Three hands, and the 39 cards they could discard
+  static const int MAX_SLOTS = NUM_SEATS - 1 + NUM_CARDS - RANKS_PER_SUIT;
+  // Turn from which a card that hasn't been playable yet is playable
+  static const int NEVER = NUM_CARDS;
+  // Seat whose point of view is taken, or -1 before a round starts
+  int seat = -1;
+  // Moves made this round
+  int turn = 0;
+  PileBounds piles[NUM_SUITS];
+  // The seat's own hand and discards
+  CardMask hand = 0;
+  CardMask ownDiscards = 0;
+  // Cards in the other seats' hands or discards
+  CardMask unseen = 0;
+  // Turn from which each card has been playable, or NEVER
+  uint8_t playableFrom[NUM_CARDS];
+  int handSizes[NUM_SEATS];
+  // Turn of each seat's latest discard, or -1
+  int lastDiscard[NUM_SEATS];
+  // The other seats' discards, in turn order
+  Slot discards[NUM_CARDS];
+  int discardCount = 0;
+  // Every slot, from the one taking the fewest cards to the most.
+  // Rebuilt after each move.
+  Slot slots[MAX_SLOTS];
+  int slotCount = 0;
+  // Index into slots of each seat's hand
+  int handSlot[NUM_SEATS];
+  // fitting[t + 1] is the number of unseen cards that became playable
+  // after turn t
+  int fitting[NUM_CARDS + 2];
+  double deals = 0;
+  // What sync has taken from the model, to tell when the round changed
+  DeckOrder dealtOrder{};
+  SimMove moves[NUM_CARDS];
+  uint8_t movers[NUM_CARDS];
+  // Rebuilds slots, fitting and deals
+  void update();
+  // Deals of the unseen cards in which one card that became playable on
+  // turn kind is in slots[slot]. With slot -1, all deals are counted.
+  double count(int kind, int slot) const;
+  // Chance that a card that became playable on turn kind is in slots[slot]
+  double chance(int kind, int slot) const;
+public:
+  // Starts a round, as seen by seat, which was dealt hand
+  void startRound(int seat, CardMask hand);
+  // Takes the next move of the round. The card of another seat's discard
+  // isn't looked at, as it can't be seen.
+  void played(int mover, int card);
+  void discarded(int mover, int card);
+  // Brings the inference up to date with the round on the model, as
+  // seen by seat. Only the moves made since the last sync are taken,
+  // unless it's a new round or moves were taken back since. The round
+  // must have been dealt by StraightsModel::dealHands.
+  void sync(const StraightsModel &model, int seat);
+  // Cards the inferring seat can't see
+  CardMask getUnseen() const;
+  // Deals of the unseen cards consistent with everything seen. Kept as a
+  // double, as it can be far beyond 64 bits.
+  double countDeals() const;
+  // Chance that holder has the card in hand now
+  double holdProbability(int holder, int card) const;
+  // Chance that holder discarded the card this round
+  double discardProbability(int holder, int card) const;
+  // Cards holder could have in hand now
+  CardMask possibleHand(int holder) const;
+  // The chance of each card being in each seat's hand now, all at once
+  void handProbabilities(double chances[NUM_SEATS][NUM_CARDS]) const;
+};
+
+#endif
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "loadclient.h"
+
+namespace {
+  typedef std::chrono::steady_clock Clock;
+
+  const int MAX_EVENTS = 256;
+  const char ESCAPE = '\x1b';
+  const std::string PROMPT = "> ";
+  const std::string HAND = "Your hand: ";
+  const std::string LEGAL_PLAYS = "Legal plays: ";
+  const std::string GAME_OVER = "The game is over.";
+
+  struct Connection {
+    int fd = -1;
+    bool connected = false;
+    bool closed = false;
+    bool gameOver = false;
+    // Received text not yet split into lines, with escape codes removed
+    std::string text;
+    // Received bytes that may be the start of an escape code
+    std::string partial;
+    std::string outgoing;
+    bool writing = false;
+    std::vector<std::string> hand;
+    std::vector<std::string> legalPlays;
+    bool awaitingPrompt = false;
+    Clock::time_point sentAt;
+  };
+
+  std::vector<std::string> splitWords(const std::string &line) {
+    std::istringstream in{line};
+    std::vector<std::string> words;
+    std::string word;
+    while (in >> word) words.push_back(word);
+    return words;
+  }
+
+  // Appends data to text, dropping the terminal escape codes TextView uses
+  void appendText(Connection &c, const char *data, const size_t n) {
+    c.partial.append(data, n);
+    size_t i = 0;
+    while (i < c.partial.size()) {
+      if (c.partial[i] != ESCAPE) {
+        c.text += c.partial[i++];
+        continue;
+      }
+      const size_t end = c.partial.find('m', i);
+      if (end == std::string::npos) break;
+      i = end + 1;
+    }
+    c.partial.erase(0, i);
+  }
+
+  class LoadClient {
+    const LoadConfig &config;
+    int epollFd;
+    std::vector<Connection> connections;
+    std::vector<double> latencies;
+    unsigned open = 0;
+    unsigned failed = 0;
+
+    void watch(Connection &c, int op) {
+      epoll_event event;
+      event.events = EPOLLIN | EPOLLRDHUP |
+        (!c.connected || c.writing ? EPOLLOUT : 0);
+      event.data.u32 = &c - connections.data();
+      epoll_ctl(epollFd, op, c.fd, &event);
+    }
+
+    void finish(Connection &c) {
+      if (c.closed) return;
+      c.closed = true;
+      if (!c.gameOver) failed++;
+      epoll_ctl(epollFd, EPOLL_CTL_DEL, c.fd, nullptr);
+      close(c.fd);
+      open--;
+    }
+
+    void write(Connection &c) {
+      while (!c.outgoing.empty()) {
+        const ssize_t n = send(c.fd, c.outgoing.data(), c.outgoing.size(),
+                               MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+          finish(c);
+          return;
+        }
+        c.outgoing.erase(0, n);
+      }
+      const bool writing = !c.outgoing.empty();
+      if (writing != c.writing) {
+        c.writing = writing;
+        watch(c, EPOLL_CTL_MOD);
+      }
+    }
+
+    // Answers a prompt with the first legal play, or the first discard
+    void move(Connection &c) {
+      const Clock::time_point now = Clock::now();
+      if (c.awaitingPrompt) {
+        latencies.push_back(
+          std::chrono::duration<double, std::micro>(now - c.sentAt).count());
+      }
+      if (!c.legalPlays.empty()) {
+        c.outgoing += "play " + c.legalPlays[0] + "\n";
+      } else if (!c.hand.empty()) {
+        c.outgoing += "discard " + c.hand[0] + "\n";
+      } else {
+        c.outgoing += "quit\n";
+      }
+      c.legalPlays.clear();
+      c.hand.clear();
+      c.awaitingPrompt = true;
+      c.sentAt = now;
+      write(c);
+    }
+
+    void read(Connection &c) {
+      char buffer[4096];
+      bool ended = false;
+      while (true) {
+        const ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+          ended = true;
+          break;
+        }
+        appendText(c, buffer, n);
+      }
+      size_t start = 0;
+      for (size_t end; (end = c.text.find('\n', start)) != std::string::npos;
+           start = end + 1) {
+        const std::string line = c.text.substr(start, end - start);
+        if (line.compare(0, HAND.size(), HAND) == 0) {
+          c.hand = splitWords(line.substr(HAND.size()));
+        } else if (line.compare(0, LEGAL_PLAYS.size(), LEGAL_PLAYS) == 0) {
+          c.legalPlays = splitWords(line.substr(LEGAL_PLAYS.size()));
+        } else if (line == GAME_OVER) {
+          c.gameOver = true;
+        }
+      }
+      c.text.erase(0, start);
+      if (ended) {
+        finish(c);
+      } else if (c.text == PROMPT) {
+        c.text.clear();
+        move(c);
+      }
+    }
+
+  public:
+    explicit LoadClient(const LoadConfig &config) :
+      config{config}, epollFd{epoll_create1(EPOLL_CLOEXEC)},
+      connections(config.connections)
+    {
+      if (epollFd < 0) throw SocketError{};
+    }
+
+    ~LoadClient() {
+      for (Connection &c : connections) {
+        if (!c.closed && c.fd >= 0) close(c.fd);
+      }
+      close(epollFd);
+    }
+
+    void run(std::ostream &out) {
+      const Clock::time_point start = Clock::now();
+      for (Connection &c : connections) {
+        c.fd = connectTo(config.address);
+        open++;
+        watch(c, EPOLL_CTL_ADD);
+      }
+      epoll_event events[MAX_EVENTS];
+      bool timedOut = false;
+      while (open > 0) {
+        const int n = epoll_wait(epollFd, events, MAX_EVENTS,
+                                 config.timeoutSeconds * 1000);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+          timedOut = true;
+          break;
+        }
+        for (int i = 0; i < n; i++) {
+          Connection &c = connections[events[i].data.u32];
+          if (c.closed) continue;
+          if (!c.connected && (events[i].events & EPOLLOUT)) {
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error != 0) {
+              finish(c);
+              continue;
+            }
+            c.connected = true;
+            watch(c, EPOLL_CTL_MOD);
+          } else if (events[i].events & EPOLLOUT) {
+            write(c);
+          }
+          if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+            read(c);
+          }
+        }
+      }
+      for (Connection &c : connections) finish(c);
+      const std::chrono::duration<double> elapsed = Clock::now() - start;
+
+      std::sort(latencies.begin(), latencies.end());
+      auto percentile = [this](double p) {
+        if (latencies.empty()) return 0.0;
+        return latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+      };
+      out << std::fixed << std::setprecision(1);
+      out << "server: " << netAddressName(config.address) << std::endl;
+      out << "connections: " << config.connections << std::endl;
+      out << "games finished: " << config.connections - failed << std::endl;
+      out << "failed: " << failed << (timedOut ? " (timed out)" : "")
+          << std::endl;
+      out << "turns: " << latencies.size() << std::endl;
+      out << "seconds: " << elapsed.count() << std::endl;
+      out << "turns/sec: " << latencies.size() / elapsed.count() << std::endl;
+      out << "turn latency (us): p50 " << percentile(0.5)
+          << " p90 " << percentile(0.9) << " p99 " << percentile(0.99)
+          << " max " << percentile(1) << std::endl;
+    }
+
+    bool succeeded() const {
+      return failed == 0;
+    }
+  };
+}
+
+bool runLoadClient(const LoadConfig &config, std::ostream &out) {
+  LoadClient client{config};
+  client.run(out);
+  return client.succeeded();
+}
@@ -0,0 +1,31 @@
+#ifndef _H_LOADCLIENT
+#define _H_LOADCLIENT
+
+/*
+A scripted client for load testing the game server. It opens many
+connections at once from a single epoll loop, and each one plays a whole
+game as a human would: at every prompt it plays its first legal card, or
+discards its first card if it has none.
+
+A turn's latency is the time from sending a move to receiving the next
+prompt, which covers the server handling the move and the other seats'
+turns in between.
+*/
+
+#include <iostream>
+
+#include "net.h"
+
+struct LoadConfig {
+  NetAddress address;
+  unsigned connections = 100;
+  // Gives up if nothing is received for this long
+  unsigned timeoutSeconds = 30;
+};
+
+// Plays a game on each connection until the server closes them, and
+// prints the latency percentiles and throughput to out.
+// Returns false if any connection failed or timed out.
+bool runLoadClient(const LoadConfig &config, std::ostream &out);
+
+#endif
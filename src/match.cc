@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <string>
+
+#include "match.h"
+#include "model.h"
+#include "view.h"
+#include "player.h"
+#include "simulation.h"
+#include "tournament.h"
+#include "debug.h"
+
+const uint64_t MatchStats::MIN_DEALS = 16;
+
+void Moments::add(const double x) {
+  count++;
+  sum += x;
+  sumSquares += x * x;
+}
+
+double Moments::mean() const {
+  return count > 0 ? sum / count : 0;
+}
+
+double Moments::variance() const {
+  if (count < 2) return 0;
+  const double m = mean();
+  return std::max(0.0, (sumSquares - count * m * m) / (count - 1));
+}
+
+double Moments::margin() const {
+  return count > 0 ? 1.96 * std::sqrt(variance() / count) : 0;
+}
+
+void MatchStats::add(const double firstPerSeat, const double secondPerSeat) {
+  difference.add(secondPerSeat - firstPerSeat);
+  first.add(firstPerSeat);
+  second.add(secondPerSeat);
+}
+
+uint64_t MatchStats::getDeals() const {
+  return difference.count;
+}
+
+double MatchStats::llr(const double delta) const {
+  // Normal approximation, with the variance estimated from the deals so far
+  const double variance = difference.variance();
+  if (variance <= 0) return 0;
+  return (delta * difference.sum -
+          difference.count * delta * delta / 2) / variance;
+}
+
+MatchVerdict MatchStats::verdict(const MatchConfig &config) const {
+  if (getDeals() < MIN_DEALS) return MatchVerdict::UNDECIDED;
+  if (difference.variance() <= 0) {
+    // Every deal came out the same, e.g. when a strategy plays itself
+    if (difference.mean() >= config.delta) return MatchVerdict::FIRST_BETTER;
+    if (difference.mean() <= -config.delta) return MatchVerdict::SECOND_BETTER;
+    return MatchVerdict::NO_DIFFERENCE;
+  }
+  const double upper = std::log((1 - config.beta) / config.alpha);
+  const double lower = std::log(config.beta / (1 - config.alpha));
+  // A positive difference means the second strategy took more points
+  const double firstBetter = llr(config.delta);
+  const double secondBetter = llr(-config.delta);
+  if (firstBetter >= upper) return MatchVerdict::FIRST_BETTER;
+  if (secondBetter >= upper) return MatchVerdict::SECOND_BETTER;
+  if (firstBetter <= lower && secondBetter <= lower) {
+    return MatchVerdict::NO_DIFFERENCE;
+  }
+  return MatchVerdict::UNDECIDED;
+}
+
+void MatchStats::print(std::ostream &out, const MatchConfig &config) const {
+  out << std::fixed << std::setprecision(3);
+  out << "deals: " << getDeals() << " (" << 2 * getDeals() << " rounds)"
+      << std::endl;
+  out << config.first << " points/seat/deal: " << first.mean()
+      << " +/- " << first.margin() << std::endl;
+  out << config.second << " points/seat/deal: " << second.mean()
+      << " +/- " << second.margin() << std::endl;
+  out << "difference (" << config.second << " - " << config.first << "): "
+      << difference.mean() << " +/- " << difference.margin() << std::endl;
+  out << "llr: " << llr(config.delta) << " (" << config.first << " better), "
+      << llr(-config.delta) << " (" << config.second << " better), bounds ["
+      << std::log(config.beta / (1 - config.alpha)) << ", "
+      << std::log((1 - config.beta) / config.alpha) << "]" << std::endl;
+  out << "verdict: ";
+  switch (verdict(config)) {
+    case MatchVerdict::FIRST_BETTER:
+      out << config.first << " is better" << std::endl;
+      break;
+    case MatchVerdict::SECOND_BETTER:
+      out << config.second << " is better" << std::endl;
+      break;
+    case MatchVerdict::NO_DIFFERENCE:
+      out << "no difference of " << config.delta << " or more" << std::endl;
+      break;
+    default:
+      out << "undecided" << std::endl;
+  }
+}
+
+void playDuplicateDeal(const MatchConfig &config, const unsigned dealSeed,
+                       MatchStats &stats) {
+  double points[2] = {0, 0};
+  // Each seating is played on a fresh model, so both get the deal that
+  // the seed's first shuffle makes
+  for (int swap = 0; swap < 2; swap++) {
+    const char a = swap ? config.second : config.first;
+    const char b = swap ? config.first : config.second;
+    const std::string players{a, b, a, b};
+    StraightsModel model{dealSeed, config.shuffle};
+    NullView view;
+    StraightsController controller{view, model, config.strategies};
+    controller.initializePlayers(players);
+    controller.playRound();
+    int seat = 0;
+    model.forEachPlayer([&points, &seat, swap](Player &p) {
+      // Seats 1 and 3 hold the first strategy unless swapped
+      points[(seat++ % 2) ^ swap] += p.getRoundScore();
+    });
+  }
+  // Each strategy played four seats over the two seatings
+  stats.add(points[0] / 4, points[1] / 4);
+}
+
+void runMatch(const MatchConfig &config, std::ostream &out) {
+  checkHeadlessPlayers(std::string{config.first, config.second});
+  unsigned seed = config.seed;
+  if (seed == Deck::DEFAULT_SEED) {
+    seed = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+  Debug::print("Match seed: " + std::to_string(seed));
+
+  const std::clock_t cpuStart = std::clock();
+  MatchStats stats;
+  while (stats.getDeals() < config.maxDeals &&
+         stats.verdict(config) == MatchVerdict::UNDECIDED) {
+    playDuplicateDeal(config, deriveGameSeed(seed, stats.getDeals()), stats);
+  }
+  const double cpuSeconds =
+    static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+  out << "seed: " << seed << std::endl;
+  out << "match: " << config.first << " vs " << config.second << std::endl;
+  stats.print(out, config);
+  out << "cpu seconds: " << cpuSeconds << std::endl;
+  // Assumes the deals not played would have cost the average so far
+  const uint64_t deals = stats.getDeals();
+  const double saved = deals > 0 ?
+    cpuSeconds / deals * (config.maxDeals - deals) : 0;
+  out << "cpu seconds saved: " << saved << " (" << std::setprecision(1)
+      << (config.maxDeals > 0 ? 100.0 * (config.maxDeals - deals) /
+                                config.maxDeals : 0.0)
+      << "% of a fixed " << config.maxDeals << "-deal run)" << std::endl;
+}
@@ -0,0 +1,86 @@
+#ifndef _H_MATCH
+#define _H_MATCH
+
+/*
+Head-to-head matches between two computer strategies, using duplicate
+deals so that the luck of the cards mostly cancels out.
+
+Every deal is played twice from the same Deck seed: once with the first
+strategy in seats 1 and 3 and the second in seats 2 and 4, and once with
+the seats swapped. Each strategy so holds every hand once, and the
+difference in the points they took is scored for the deal. Deals are
+single rounds rather than whole games, since how long a game lasts
+depends on how it's played.
+
+A sequential probability ratio test stops the match as soon as one
+strategy is better by at least delta points per seat per deal, or it's
+clear neither is, instead of always playing the full number of deals.
+*/
+
+#include <cstdint>
+#include <iostream>
+
+#include "deck.h"
+#include "controller.h"
+
+struct MatchConfig {
+  // Computer player types ('c', 'm', 'e' or 't') of the two strategies
+  char first = 'c';
+  char second = 'm';
+  // If the seed is Deck::DEFAULT_SEED, a seed is picked from the current time.
+  unsigned seed = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  StrategyOptions strategies;
+  // Most deals to play, and the size of the equivalent fixed-size run
+  uint64_t maxDeals = 10000;
+  // Smallest difference in points per seat per deal worth detecting
+  double delta = 0.5;
+  // Chances of calling a difference that isn't there, and of missing
+  // one of delta
+  double alpha = 0.05;
+  double beta = 0.05;
+};
+
+// The outcome of a sequential test
+enum class MatchVerdict { FIRST_BETTER, SECOND_BETTER, NO_DIFFERENCE, UNDECIDED };
+
+// Running mean and variance of a series of samples
+struct Moments {
+  uint64_t count = 0;
+  double sum = 0;
+  double sumSquares = 0;
+  void add(double x);
+  double mean() const;
+  double variance() const;
+  // Half the width of the 95% confidence interval of the mean
+  double margin() const;
+};
+
+// Accumulates the per-deal scores and runs the SPRT on their differences
+class MatchStats {
+  // The second strategy's points minus the first's, per seat
+  Moments difference;
+  Moments first;
+  Moments second;
+public:
+  // Deals needed before the variance is trusted enough to stop
+  static const uint64_t MIN_DEALS;
+  // Adds one deal's points per seat taken by each strategy
+  void add(double firstPerSeat, double secondPerSeat);
+  uint64_t getDeals() const;
+  // Log likelihood ratio of a mean difference of delta against none
+  double llr(double delta) const;
+  MatchVerdict verdict(const MatchConfig &config) const;
+  void print(std::ostream &out, const MatchConfig &config) const;
+};
+
+// Plays one deal twice with the seats swapped, and adds it to stats
+void playDuplicateDeal(const MatchConfig &config, unsigned dealSeed,
+                       MatchStats &stats);
+
+// Plays deals until the SPRT decides or config.maxDeals are played,
+// and prints the results to out.
+// Throws InvalidPlayerType unless both strategies are computers.
+void runMatch(const MatchConfig &config, std::ostream &out);
+
+#endif
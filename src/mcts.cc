@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "mcts.h"
+#include "model.h"
+#include "player.h"
+#include "deck.h"
+#include "debug.h"
+#include "trace.h"
+
+// Largest number of points one seat can discard in a round, used to
+// scale rewards to about [0, 1]
+const double MAX_PENALTY = 91;
+// How often a timed or cancellable search checks the clock and stop flag
+const unsigned CLOCK_CHECK_INTERVAL = 64;
+// Ways the other seats' turns are sampled when pondering
+const unsigned PONDER_SAMPLES = 256;
+
+namespace {
+  // The move the rollouts make: a random legal play, or the lowest
+  // card when there is none
+  SimMove rolloutMove(const SimState &state, Xoshiro256 &rng) {
+    CardMask legal = state.legalPlays();
+    if (legal) {
+      for (int skip = boundedRandom(rng, cardCount(legal)); skip > 0; skip--) {
+        legal &= legal - 1;
+      }
+      return playMove(lowestCard(legal));
+    }
+    const CardMask hand = state.hands[state.toMove];
+    int rank = 1;
+    while (!(hand & rankMask(rank))) rank++;
+    return discardMove(lowestCard(hand & rankMask(rank)));
+  }
+}
+
+IsmctsSearch::IsmctsSearch(const InfoSet &info, const uint64_t seed,
+                           const double exploration) :
+  info{info}, exploration{exploration}, rng{seed}
+{
+  nodes.emplace_back(NO_MOVE, NUM_SEATS, -1);
+}
+
+SimState IsmctsSearch::determinize() {
+  // Deal the unseen cards to the opponents in a random order.
+  // Whatever is left over was discarded.
+  int cards[NUM_CARDS];
+  int n = 0;
+  for (CardMask m = info.unseen; m; m &= m - 1) {
+    cards[n++] = lowestCard(m);
+  }
+  SimState state = info.state;
+  int dealt = 0;
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    if (seat == info.state.toMove) continue;
+    for (int i = 0; i < info.handSizes[seat] && dealt < n; i++, dealt++) {
+      std::swap(cards[dealt], cards[dealt + boundedRandom(rng, n - dealt)]);
+      state.hands[seat] |= cardBit(cards[dealt]);
+    }
+  }
+  return state;
+}
+
+void IsmctsSearch::rollout(SimState &state) {
+  while (!state.isRoundOver()) {
+    state.apply(rolloutMove(state, rng));
+  }
+}
+
+void IsmctsSearch::iterate() {
+  SimState state = determinize();
+  int node = 0;
+  // Selection and expansion
+  while (!state.isRoundOver()) {
+    SimMove moves[RANKS_PER_SUIT];
+    const int n = state.legalMoves(moves);
+    // Moves from this node that have been tried, indexed by SimMove
+    bool tried[DISCARD + NUM_CARDS] = {false};
+    int best = -1;
+    double bestScore = -1;
+    for (int child = nodes[node].firstChild; child != -1;
+         child = nodes[child].nextSibling) {
+      const SimMove move = nodes[child].move;
+      tried[move] = true;
+      if (std::find(moves, moves + n, move) == moves + n) continue;
+      Node &c = nodes[child];
+      c.availability++;
+      const double score = c.reward / c.visits +
+        exploration * std::sqrt(std::log(c.availability) / c.visits);
+      if (score > bestScore) {
+        bestScore = score;
+        best = child;
+      }
+    }
+    SimMove untried[RANKS_PER_SUIT];
+    int untriedCount = 0;
+    for (int i = 0; i < n; i++) {
+      if (!tried[moves[i]]) untried[untriedCount++] = moves[i];
+    }
+    if (untriedCount > 0) {
+      const SimMove move = untried[boundedRandom(rng, untriedCount)];
+      nodes.emplace_back(move, state.toMove, node);
+      const int child = nodes.size() - 1;
+      nodes[child].nextSibling = nodes[node].firstChild;
+      nodes[child].availability = 1;
+      nodes[node].firstChild = child;
+      state.apply(move);
+      node = child;
+      break;
+    }
+    state.apply(nodes[best].move);
+    node = best;
+  }
+  rollout(state);
+  // Backpropagation, rewarding each move for the seat that made it
+  int total = 0;
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    total += state.penalties[seat];
+  }
+  for (; node != -1; node = nodes[node].parent) {
+    Node &n = nodes[node];
+    n.visits++;
+    if (n.seat >= NUM_SEATS) continue;
+    const int own = state.penalties[n.seat];
+    const double others = (total - own) / double(NUM_SEATS - 1);
+    n.reward += 0.5 + (others - own) / (2 * MAX_PENALTY);
+  }
+}
+
+void IsmctsSearch::addRootVisits(std::vector<unsigned> &visits) const {
+  for (int child = nodes[0].firstChild; child != -1;
+       child = nodes[child].nextSibling) {
+    visits[nodes[child].move] += nodes[child].visits;
+  }
+}
+
+unsigned IsmctsSearch::getIterations() const {
+  return nodes[0].visits;
+}
+
+MctsStrategy::MctsStrategy(View& view, StraightsModel &model,
+                           const MctsConfig config) :
+  TurnStrategy(view, model), config{config}
+{}
+
+MctsStrategy::~MctsStrategy() {
+  stopPondering();
+}
+
+InfoSet MctsStrategy::getInfoSet(const Player &p) const {
+  const SimState full = model.getSimState(p);
+  InfoSet info;
+  info.state = full;
+  CardMask visible = 0;
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    info.handSizes[seat] = cardCount(full.hands[seat]);
+    info.state.penalties[seat] = 0;
+    if (seat != full.toMove) info.state.hands[seat] = 0;
+  }
+  for (int suit = 1; suit <= NUM_SUITS; suit++) {
+    visible |= pileMask(suit, full.piles[suit - 1]);
+  }
+  visible |= full.hands[full.toMove];
+  for (const Card *card : p.getDiscards()) {
+    visible |= cardBit(card->getIndex());
+  }
+  info.unseen = ALL_CARDS & ~visible;
+  return info;
+}
+
+uint64_t MctsStrategy::infoSetKey(const InfoSet &info) {
+  const SimState &state = info.state;
+  uint64_t piles = 0;
+  uint64_t sizes = state.toMove;
+  for (int i = 0; i < NUM_SUITS; i++) {
+    piles = (piles << 16) | (state.piles[i].low << 8) | state.piles[i].high;
+  }
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    sizes = (sizes << 8) | info.handSizes[seat];
+  }
+  uint64_t key = state.hands[state.toMove];
+  for (const uint64_t part : {info.unseen, piles, sizes}) {
+    uint64_t mixed = key ^ part;
+    key = splitMix64(mixed);
+  }
+  return key;
+}
+
+SimMove MctsStrategy::chooseMove(const InfoSet &info) {
+  return search(info, decisions++, nullptr);
+}
+
+SimMove MctsStrategy::search(const InfoSet &info, const uint64_t decision,
+                             const std::atomic<bool> *stop) const {
+  SimMove moves[RANKS_PER_SUIT];
+  const int n = info.state.legalMoves(moves);
+  if (n == 1) return moves[0];
+
+  // Not resolveThreads: the trees' seeds and shares of the playouts
+  // depend on the thread count, so 0 can't mean the machine's core
+  // count without the moves changing from one machine to the next
+  const unsigned threads = std::max(1u, config.threads);
+  std::vector<std::vector<unsigned>> visits(threads,
+    std::vector<unsigned>(DISCARD + NUM_CARDS, 0));
+  auto run = [this, &info, &visits, threads, decision, stop](unsigned t) {
+    uint64_t seed = config.seed + decision * threads + t;
+    IsmctsSearch tree{info, splitMix64(seed), config.exploration};
+    if (config.milliseconds > 0) {
+      const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(config.milliseconds);
+      do {
+        for (unsigned i = 0; i < CLOCK_CHECK_INTERVAL; i++) tree.iterate();
+      } while (std::chrono::steady_clock::now() < deadline &&
+               !(stop && *stop));
+    } else {
+      const unsigned iterations = (config.iterations + threads - 1) / threads;
+      for (unsigned i = 0; i < iterations; i++) {
+        if (stop && i % CLOCK_CHECK_INTERVAL == 0 && *stop) break;
+        tree.iterate();
+      }
+    }
+    Trace::add(TraceCounter::MCTS_ITERATIONS, tree.getIterations());
+    tree.addRootVisits(visits[t]);
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; t++) {
+    pool.emplace_back(run, t);
+  }
+  run(0);
+  for (auto &thread : pool) {
+    thread.join();
+  }
+  if (stop && *stop) return NO_MOVE;
+
+  SimMove best = moves[0];
+  unsigned bestVisits = 0;
+  for (int i = 0; i < n; i++) {
+    unsigned total = 0;
+    for (auto &v : visits) total += v[moves[i]];
+    if (total > bestVisits) {
+      bestVisits = total;
+      best = moves[i];
+    }
+  }
+  return best;
+}
+
+void MctsStrategy::ponder(const InfoSet after, const uint64_t decision) {
+  const int me = after.state.toMove;
+
+  // Sample the other seats' turns with the rollout policy, counting how
+  // often each resulting position comes up
+  Xoshiro256 rng{config.seed ^ (decision << 32)};
+  std::unordered_map<uint64_t, std::pair<unsigned, InfoSet>> predicted;
+  for (unsigned sample = 0; sample < PONDER_SAMPLES && !stopPonder; sample++) {
+    int cards[NUM_CARDS];
+    int n = 0;
+    for (CardMask m = after.unseen; m; m &= m - 1) {
+      cards[n++] = lowestCard(m);
+    }
+    SimState state = after.state;
+    state.toMove = (me + 1) % NUM_SEATS;
+    int dealt = 0;
+    for (int seat = 0; seat < NUM_SEATS; seat++) {
+      if (seat == me) continue;
+      for (int i = 0; i < after.handSizes[seat] && dealt < n; i++, dealt++) {
+        std::swap(cards[dealt], cards[dealt + boundedRandom(rng, n - dealt)]);
+        state.hands[seat] |= cardBit(cards[dealt]);
+      }
+    }
+    InfoSet next = after;
+    while (state.toMove != me) {
+      const int seat = state.toMove;
+      if (state.hands[seat]) {
+        const SimMove move = rolloutMove(state, rng);
+        next.handSizes[seat]--;
+        if (!isDiscard(move)) next.unseen &= ~cardBit(moveCard(move));
+        state.apply(move);
+      } else {
+        state.toMove = (seat + 1) % NUM_SEATS;
+      }
+    }
+    std::copy(state.piles, state.piles + NUM_SUITS, next.state.piles);
+    next.state.toMove = me;
+    auto &entry = predicted[infoSetKey(next)];
+    entry.first++;
+    entry.second = next;
+  }
+
+  // Search the likeliest positions first
+  std::vector<std::pair<unsigned, InfoSet>> order;
+  for (auto &entry : predicted) order.push_back(entry.second);
+  std::stable_sort(order.begin(), order.end(),
+    [](const std::pair<unsigned, InfoSet> &a,
+       const std::pair<unsigned, InfoSet> &b) { return a.first > b.first; });
+  for (const auto &position : order) {
+    if (stopPonder) return;
+    const SimMove move = search(position.second, decision, &stopPonder);
+    if (move == NO_MOVE) return;
+    std::lock_guard<std::mutex> lock{ponderMutex};
+    ponderedMoves[infoSetKey(position.second)] = move;
+  }
+}
+
+void MctsStrategy::startPondering(const InfoSet &after) {
+  stopPondering();
+  stopPonder = false;
+  ponderThread = std::thread{&MctsStrategy::ponder, this, after, decisions};
+}
+
+void MctsStrategy::stopPondering() {
+  stopPonder = true;
+  if (ponderThread.joinable()) ponderThread.join();
+}
+
+void MctsStrategy::doTurn(ComputerPlayer &p) {
+  if (p.getHand().empty()) return;
+  stopPondering();
+  const InfoSet info = getInfoSet(p);
+  const uint64_t decision = decisions++;
+  SimMove move = NO_MOVE;
+  {
+    std::lock_guard<std::mutex> lock{ponderMutex};
+    auto found = ponderedMoves.find(infoSetKey(info));
+    if (found != ponderedMoves.end()) move = found->second;
+    ponderedMoves.clear();
+  }
+  // A kept reply is only used if it's legal, in case keys ever collide
+  SimMove moves[RANKS_PER_SUIT];
+  const int n = info.state.legalMoves(moves);
+  if (std::find(moves, moves + n, move) == moves + n) {
+    if (config.ponder) ponderMisses++;
+    TraceScope trace{TraceSpan::DECISION};
+    move = search(info, decision, nullptr);
+  } else {
+    ponderHits++;
+  }
+  Card *card = model.getCard(moveCard(move));
+  if (isDiscard(move)) {
+    discardCard(p, *card);
+  } else {
+    playCard(p, *card);
+  }
+  if (config.ponder && !p.getHand().empty()) {
+    startPondering(getInfoSet(p));
+  }
+}
+
+void MctsStrategy::resetGame() {
+  stopPondering();
+  ponderedMoves.clear();
+  decisions = 0;
+}
+
+void MctsStrategy::addStats(StrategyStats &stats) const {
+  stats.ponderHits += ponderHits;
+  stats.ponderMisses += ponderMisses;
+}
@@ -0,0 +1,117 @@
+#ifndef _H_MCTS
+#define _H_MCTS
+
+/*
+A search based TurnStrategy using information set Monte Carlo tree search
+(single observer ISMCTS). Each playout deals the cards the player can't see
+at random, consistent with the hand sizes everyone has, and plays the round
+out on a SimState. The tree is shared between all of these deals, and only
+the moves legal in the current deal are considered at each node.
+
+Several trees can be searched on separate threads, in which case the visit
+counts at their roots are added together before choosing a move.
+
+With pondering on, the strategy keeps searching on a background thread
+while the other seats move. It samples how their turns might go, and
+searches the most likely positions it could face next, keeping the reply
+for each. When its turn comes the background search is cancelled, and a
+kept reply is used if the real position is one of them. Each search is
+seeded by its decision number, so a pondered reply is the same move the
+search would have chosen on the spot.
+*/
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "controller.h"
+#include "simstate.h"
+#include "rng.h"
+
+// What a seat knows about the round: its own hand, the piles, and how
+// many cards everyone holds. Opponents' hands are empty in state.
+struct InfoSet {
+  SimState state;
+  // Cards in opponents' hands or their discards
+  CardMask unseen = 0;
+  int handSizes[NUM_SEATS] = {0, 0, 0, 0};
+};
+
+// One search tree
+class IsmctsSearch {
+  struct Node {
+    SimMove move;
+    // Seat that made the move
+    uint8_t seat;
+    int parent;
+    int firstChild = -1;
+    int nextSibling = -1;
+    unsigned visits = 0;
+    // Times the move was legal when its parent was visited
+    unsigned availability = 0;
+    double reward = 0;
+    Node(SimMove move, uint8_t seat, int parent) :
+      move{move}, seat{seat}, parent{parent} {}
+  };
+  const InfoSet &info;
+  const double exploration;
+  Xoshiro256 rng;
+  std::vector<Node> nodes;
+  SimState determinize();
+  // Plays the rest of the round with random legal plays, discarding
+  // the lowest card when there are none
+  void rollout(SimState &state);
+public:
+  IsmctsSearch(const InfoSet &info, uint64_t seed, double exploration);
+  // Runs one playout from the root
+  void iterate();
+  // Adds the visits of each of the root's moves to visits,
+  // which is indexed by SimMove
+  void addRootVisits(std::vector<unsigned> &visits) const;
+  // Number of playouts run so far
+  unsigned getIterations() const;
+};
+
+class MctsStrategy: public TurnStrategy {
+  const MctsConfig config;
+  uint64_t decisions = 0;
+  // Searches with the seeds of the given decision. Returns NO_MOVE if
+  // stop is set before the search finishes.
+  SimMove search(const InfoSet &info, uint64_t decision,
+                 const std::atomic<bool> *stop) const;
+  std::thread ponderThread;
+  std::atomic<bool> stopPonder{false};
+  // Guards ponderedMoves, which is written by the ponder thread
+  std::mutex ponderMutex;
+  // Replies found while pondering, keyed by infoSetKey
+  std::unordered_map<uint64_t, SimMove> ponderedMoves;
+  uint64_t ponderHits = 0;
+  uint64_t ponderMisses = 0;
+  // Searches likely next positions from after, the information set right
+  // after this player's move (so with it still to move), for the given
+  // decision
+  void ponder(InfoSet after, uint64_t decision);
+  void startPondering(const InfoSet &after);
+  // Cancels the background search and waits for it to finish
+  void stopPondering();
+public:
+  MctsStrategy(View& view, StraightsModel &model, MctsConfig config);
+  ~MctsStrategy();
+  // What p can see of the current round
+  InfoSet getInfoSet(const Player &p) const;
+  // Identifies an information set, for looking up pondered replies
+  static uint64_t infoSetKey(const InfoSet &info);
+  // Searches for the best move in the information set
+  SimMove chooseMove(const InfoSet &info);
+  void doTurn(ComputerPlayer &p) override;
+  // Cancels any pondering and starts the decision seeds over. The
+  // ponder counts are kept.
+  void resetGame() override;
+  // Adds the turns answered with a pondered reply, and the turns that had
+  // to search
+  void addStats(StrategyStats &stats) const override;
+};
+
+#endif
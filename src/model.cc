@@ -1,25 +1,91 @@
 #include <algorithm>
+#include <cassert>
 
 #include "model.h"
 #include "controller.h"
 #include "deck.h"
 #include "debug.h"
+#include "trace.h"
 
 const int INIT_CARDS_IN_HAND = 13;
 const int StraightsModel::MAX_SCORE = 80;
 
-StraightsModel::StraightsModel(const unsigned seed) : deck{seed}
-{}
+StraightsModel::StraightsModel(const unsigned seed, const ShuffleMode mode) :
+  deck{seed, mode}
+{
+  owner.fill(NO_OWNER);
+  journal.reserve(NUM_CARDS);
+}
 
 void StraightsModel::dealHands() {
-  for (auto& p : players) {
+  TraceScope trace{TraceSpan::DEAL};
+  for (unsigned seat = 0; seat < players.size(); seat++) {
+    Player &p = *players[seat];
     for (int i = 0; i < INIT_CARDS_IN_HAND; ++i) {
-      deck.dealCard(*p);
+      deck.dealCard(p);
+    }
+    CardMask hand = p.getHandMask();
+    for (; hand; hand &= hand - 1) {
+      owner[lowestCard(hand)] = seat;
+      if (seat < NUM_SEATS) positionHash ^= ZOBRIST.hand[seat][lowestCard(hand)];
     }
   }
+  setToMove(owner[cardIndex(SPADES, SEVEN)]);
+  checkHash();
   return;
 }
 
+void StraightsModel::dealHands(const DeckOrder &order) {
+  deck.setOrder(order);
+  dealHands();
+}
+
+void StraightsModel::loadRound(const DeckOrder &order,
+                               const CardMask held[NUM_SEATS],
+                               const std::vector<std::pair<int, CardId>> &discards,
+                               const PileBounds loadedPiles[NUM_SUITS],
+                               const int totalScores[NUM_SEATS]) {
+  resetRound();
+  deck.setOrder(order);
+  CardMask dealt[NUM_SEATS];
+  int left = 0;
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    dealt[seat] = held[seat];
+    left += cardCount(held[seat]);
+  }
+  for (const auto &discard : discards) {
+    dealt[discard.first] |= discard.second.bit();
+  }
+  for (unsigned seat = 0; seat < players.size() && seat < NUM_SEATS; seat++) {
+    Player &p = *players[seat];
+    p.reset(totalScores[seat]);
+    for (int i = 0; i < INIT_CARDS_IN_HAND; i++) {
+      const uint8_t index = order[seat * INIT_CARDS_IN_HAND + i];
+      if (!(dealt[seat] & cardBit(index))) continue;
+      p.giveCard(*deck.getCard(index));
+      if (held[seat] & cardBit(index)) owner[index] = seat;
+    }
+  }
+  for (const auto &discard : discards) {
+    players[discard.first]->discardCard(*deck.getCard(discard.second));
+    discardMasks[discard.first] |= discard.second.bit();
+  }
+  for (int suit = 0; suit < NUM_SUITS; suit++) {
+    piles[suit] = loadedPiles[suit];
+  }
+  frontier = playableMask(piles);
+  // One card leaves a hand each turn, starting with the seven of spades
+  const CardId sevenOfSpades = CardId::of(SPADES, SEVEN);
+  const int starter = std::find(order.begin(), order.end(),
+    sevenOfSpades.value) - order.begin();
+  toMove = (starter / INIT_CARDS_IN_HAND + NUM_CARDS - left) % players.size();
+  positionHash = computeHash();
+}
+
+void StraightsModel::setObserver(GameObserver *o) {
+  observer = o;
+}
+
 void StraightsModel::addPlayer(std::unique_ptr<Player> p) {
   players.push_back(std::move(p));
 }
@@ -47,89 +113,145 @@ Player* StraightsModel::replacePlayer(Player &p1, std::unique_ptr<Player> p2) {;
   return nullptr;
 }
 
-void StraightsModel::loopThroughPlayers(Player* start, PlayerHandler& v) {;
-  // Find start
-  auto p = std::find_if(players.begin(), players.end(),
-    [start](std::unique_ptr<Player>& pp) {
-      return pp.get() == start;
-    });
-  // Loop untill PlayerHandler's LoopFlag is set to false;
-  while (true) {
-    (*p)->accept(v);
-    if (!v.shouldLoop()) return;
-    ++p;
-    if (p == players.end()) {
-      p = players.begin();
-    }
-  }
+Player &StraightsModel::getPlayer(const int seat) const {
+  return *players[seat];
+}
 
-  // // Find Start
-  // unsigned startIndex = 0;
-  // const unsigned endIndex = players.size();
-  // for (unsigned i = 0; i < endIndex; i++) {
-  //   if (players[i].get() == start) {
-  //     startIndex = i;
-  //     break;
-  //   }
-  // }
-  // // Loop untill Playerhandler's LoopFlag is set to false
-  // for (unsigned i = startIndex; i < endIndex; ) {
-  //   players[i]->accept(v);
-  //   if (!v.shouldLoop()) return;
-  //   i++;
-  //   if (i == endIndex) {
-  //     i = 0;
-  //   }
-  // }
-}
-
-void StraightsModel::forEachPlayer(std::function<void(Player &)> func) {
-  for (auto& p : players) {
-    func(*p);
-  }
+int StraightsModel::getPlayerCount() const {
+  return players.size();
 }
 
 Player* StraightsModel::whoHasCard(const Card& card) const {
-  auto it = players.begin();
-  for (; it != players.end(); ++it) {
-    if ((*it)->hasCard(card)) break;
-  }
-  if (it == players.end()) return nullptr;
-  return it->get();
+  const int8_t seat = owner[card.getIndex()];
+  if (seat == NO_OWNER) return nullptr;
+  return players[seat].get();
 }
 
 void StraightsModel::playCard(Player &p, Card &card) {
-  p.removeCard(card);
-  auto& pile = getPile(card);
+  if (!isLegalPlay(card)) throw InvalidPlay{};
+  Trace::add(TraceCounter::PLAYS);
+  const unsigned position = p.removeCard(card);
+  const int suit = card.getSuit() - 1;
+  PileBounds &pile = piles[suit];
+  const uint8_t rank = card.getRank();
+  positionHash ^= pileKey(suit, pile);
   if (pile.empty()) {
     Debug::print("Pile is empty.");
-    if (!card.hasRank(SEVEN)) throw InvalidPlay{};
-    pile.push_back(&card);
-  } else if (card.isFrontAdjacentTo(*pile.front())) {
+    pile.low = pile.high = rank;
+  } else if (rank < pile.low) {
     Debug::print("Is front adjacent");
-    pile.push_front(&card);
-  } else if (card.isBackAdjacentTo(*pile.back())) {
+    pile.low = rank;
+  } else {
     Debug::print("Is back adjacent");
-    pile.push_back(&card);
+    pile.high = rank;
+  }
+  updateFrontier(suit);
+  owner[card.getIndex()] = NO_OWNER;
+  const uint8_t seat = getSeat(p);
+  positionHash ^= pileKey(suit, pile) ^ ZOBRIST.hand[seat][card.getIndex()];
+  setToMove(nextSeat(seat));
+  checkHash();
+  journal.push_back(JournalEntry{seat,
+    static_cast<uint8_t>(card.getIndex()), false,
+    static_cast<uint8_t>(position)});
+  if (observer) observer->cardPlayed(seat, card.getId());
+}
+
+void StraightsModel::discardCard(Player &p, Card &card) {
+  Trace::add(TraceCounter::DISCARDS);
+  const unsigned position = p.discardCard(card);
+  owner[card.getIndex()] = NO_OWNER;
+  const uint8_t seat = getSeat(p);
+  discardMasks[seat] |= cardBit(card.getIndex());
+  positionHash ^= ZOBRIST.hand[seat][card.getIndex()] ^
+                  ZOBRIST.discard[seat][card.getIndex()];
+  setToMove(nextSeat(seat));
+  checkHash();
+  journal.push_back(JournalEntry{seat,
+    static_cast<uint8_t>(card.getIndex()), true,
+    static_cast<uint8_t>(position)});
+  if (observer) observer->cardDiscarded(seat, card.getId());
+}
+
+void StraightsModel::makeMove(Player &p, const SimMove move) {
+  Card &card = *deck.getCard(moveCard(move));
+  if (isDiscard(move)) discardCard(p, card);
+  else playCard(p, card);
+}
+
+void StraightsModel::unmakeMove() {
+  if (journal.empty()) return;
+  const JournalEntry entry = journal.back();
+  journal.pop_back();
+  Player &p = *players[entry.seat];
+  Card &card = *deck.getCard(entry.card);
+  if (entry.discard) {
+    p.undoDiscard(card, entry.handPosition);
+    discardMasks[entry.seat] &= ~cardBit(entry.card);
+    positionHash ^= ZOBRIST.discard[entry.seat][entry.card];
   } else {
-    throw InvalidPlay{};
+    // The card is at one end of its pile, since every later play is undone
+    const int suit = card.getSuit() - 1;
+    PileBounds &pile = piles[suit];
+    positionHash ^= pileKey(suit, pile);
+    if (pile.low == pile.high) pile = PileBounds{};
+    else if (card.getRank() == pile.low) pile.low++;
+    else pile.high--;
+    positionHash ^= pileKey(suit, pile);
+    updateFrontier(suit);
+    p.returnCard(card, entry.handPosition);
   }
+  positionHash ^= ZOBRIST.hand[entry.seat][entry.card];
+  owner[entry.card] = entry.seat;
+  setToMove(entry.seat);
+  checkHash();
+  if (observer) observer->moveUndone();
 }
 
-bool StraightsModel::isLegalPlay(const Card& card) const {
-  auto& pile = getPile(card);
-  if (!pile.empty()) {
-    return card.isAdjacentTo(*pile.front()) ||
-          card.isAdjacentTo(*pile.back());
+int StraightsModel::getMoveCount() const {
+  return journal.size();
+}
+
+SimMove StraightsModel::getMove(const int i, int &seat) const {
+  const JournalEntry &entry = journal[i];
+  seat = entry.seat;
+  return entry.discard ? discardMove(entry.card) : playMove(entry.card);
+}
+
+ModelSnapshot StraightsModel::snapshot() const {
+  return ModelSnapshot{journal.size()};
+}
+
+void StraightsModel::restore(const ModelSnapshot snapshot) {
+  while (journal.size() > snapshot.journalSize) {
+    unmakeMove();
   }
-  return card.hasRank(SEVEN);
+}
+
+void StraightsModel::updateFrontier(const int suit) {
+  frontier = (frontier & ~suitMask(suit + 1)) |
+             playableOnPile(suit + 1, piles[suit]);
+}
+
+bool StraightsModel::isLegalPlay(const Card& card) const {
+  return frontier & cardBit(card.getIndex());
+}
+
+CardMask StraightsModel::getPlayableMask() const {
+  return frontier;
+}
+
+CardMask StraightsModel::getLegalPlayMask(const Player &p) const {
+  return p.getHandMask() & frontier;
 }
 
 const std::vector<Card*> StraightsModel::getLegalPlays(const Player &p) const {
   std::vector<Card*> legalPlays;
-  const std::vector<Card*> &hand = p.getHand();
-  for (auto& card : hand) {
-    if(isLegalPlay(*card)) {
+  const CardMask legal = getLegalPlayMask(p);
+  if (!legal) return legalPlays;
+  // Kept in the order of the player's hand
+  for (auto& card : p.getHand()) {
+    if (legal & cardBit(card->getIndex())) {
       legalPlays.push_back(card);
     }
   }
@@ -137,15 +259,24 @@ const std::vector<Card*> StraightsModel::getLegalPlays(const Player &p) const {
 }
 
 
-Card *StraightsModel::getCard(const std::string rep) const {
+Card *StraightsModel::getCard(const std::string &rep) const {
   return deck.getCard(rep);
 }
 
+Card *StraightsModel::getCard(const CardId id) const {
+  return deck.getCard(id);
+}
+
+Card *StraightsModel::getCard(const int index) const {
+  return deck.getCard(index);
+}
+
 bool StraightsModel::isEndOfRound() const {
+  CardMask held = 0;
   for (auto& p : players) {
-    if (!p->getHand().empty()) return false;
+    held |= p->getHandMask();
   }
-  return true;
+  return held == 0;
 }
 
 bool StraightsModel::isEndOfGame() const {
@@ -157,14 +288,18 @@ bool StraightsModel::isEndOfGame() const {
   return false;
 }
 
-const std::vector<Player *> StraightsModel::getWinners() const {
+int StraightsModel::getLowestScore() const {
   int lowestScore = MAX_SCORE;
-  // Determine lowest score
   for (auto& p : players) {
     if (p->getTotalScore() < lowestScore) {
       lowestScore = p->getTotalScore();
     }
   }
+  return lowestScore;
+}
+
+const std::vector<Player *> StraightsModel::getWinners() const {
+  const int lowestScore = getLowestScore();
   // Determine any players who've reached the lowest score (to include ties)
   std::vector<Player *> winners;
   for (auto& p : players) {
@@ -180,37 +315,155 @@ void StraightsModel::resetRound() {
     p->reset();
   }
   deck.reset();
-  clubsPile.clear();
-  diamondsPile.clear();
-  heartsPile.clear();
-  spadesPile.clear();
+  for (PileBounds &pile : piles) {
+    pile = PileBounds{};
+  }
+  frontier = playableMask(piles);
+  owner.fill(NO_OWNER);
+  journal.clear();
+  for (CardMask &discarded : discardMasks) {
+    discarded = 0;
+  }
+  toMove = NO_OWNER;
+  positionHash = 0;
 }
 
+void StraightsModel::resetGame(const unsigned seed) {
+  deck.reseed(seed);
+  for (auto& p : players) {
+    p->resetGame();
+  }
+  resetRound();
+}
+
+
+void StraightsModel::setToMove(const int8_t seat) {
+  if (toMove != NO_OWNER) positionHash ^= ZOBRIST.toMove[toMove];
+  toMove = seat;
+  if (toMove != NO_OWNER) positionHash ^= ZOBRIST.toMove[toMove];
+}
+
+int8_t StraightsModel::nextSeat(const int seat) const {
+  return (seat + 1) % players.size();
+}
+
+uint64_t StraightsModel::hash() const {
+  return positionHash;
+}
+
+uint64_t StraightsModel::computeHash() const {
+  uint64_t h = 0;
+  for (int index = 0; index < NUM_CARDS; index++) {
+    if (owner[index] != NO_OWNER) h ^= ZOBRIST.hand[owner[index]][index];
+  }
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    for (CardMask m = discardMasks[seat]; m; m &= m - 1) {
+      h ^= ZOBRIST.discard[seat][lowestCard(m)];
+    }
+  }
+  for (int suit = 0; suit < NUM_SUITS; suit++) {
+    h ^= pileKey(suit, piles[suit]);
+  }
+  if (toMove != NO_OWNER) h ^= ZOBRIST.toMove[toMove];
+  return h;
+}
+
+void StraightsModel::checkHash() const {
+  #if DEBUG
+    assert(positionHash == computeHash());
+  #endif
+}
+
+int StraightsModel::getSeat(const Player &p) const {
+  for (unsigned seat = 0; seat < players.size(); seat++) {
+    if (players[seat].get() == &p) return seat;
+  }
+  return -1;
+}
+
+SimState StraightsModel::getSimState(const Player &p) const {
+  SimState state;
+  for (unsigned seat = 0; seat < players.size() && seat < NUM_SEATS; seat++) {
+    state.hands[seat] = players[seat]->getHandMask();
+    state.penalties[seat] = players[seat]->getRoundScore();
+  }
+  for (int suit = 0; suit < NUM_SUITS; suit++) {
+    state.piles[suit] = piles[suit];
+  }
+  state.toMove = getSeat(p);
+  #if DEBUG
+    // The simulation must agree with the model on what is legal, and the
+    // frontier with the piles
+    assert(frontier == playableMask(piles));
+    assert(state.playable() == frontier);
+    // Checked card by card against the rule itself: a card that isn't on
+    // the table may be played if it's a seven or is next to one of its
+    // suit that is
+    CardMask onTable = 0;
+    for (int suit = 0; suit < NUM_SUITS; suit++) {
+      onTable |= pileMask(suit + 1, piles[suit]);
+    }
+    for (int index = 0; index < NUM_CARDS; index++) {
+      const int rank = rankOfIndex(index);
+      const bool nextToTable =
+        (rank > 1 && (onTable & cardBit(index - 1))) ||
+        (rank < RANKS_PER_SUIT && (onTable & cardBit(index + 1)));
+      const bool legal = !(onTable & cardBit(index)) &&
+        (rank == STARTING_RANK || nextToTable);
+      assert(legal == static_cast<bool>(frontier & cardBit(index)));
+    }
+  #endif
+  return state;
+}
 
 void StraightsModel::shuffleDeck() {
   deck.shuffle();
 }
 
+bool StraightsModel::skipShuffles(const uint64_t n) {
+  return deck.skipShuffles(n);
+}
+
+const DeckOrder &StraightsModel::getDealOrder() const {
+  return deck.getOrder();
+}
+
+unsigned StraightsModel::getSeed() const {
+  return deck.getSeed();
+}
+
+ShuffleMode StraightsModel::getShuffleMode() const {
+  return deck.getShuffleMode();
+}
+
 void StraightsModel::printDeck() {
   deck.printDeck();
 }
 
 const std::deque<Card*> &StraightsModel::getClubsPile() const {
-  return clubsPile;
+  return getPileView(CLUBS);
 }
 
 const std::deque<Card*> &StraightsModel::getHeartsPile() const {
-  return heartsPile;
+  return getPileView(HEARTS);
 }
 
 const std::deque<Card*> &StraightsModel::getDiamondsPile() const {
-  return diamondsPile;
+  return getPileView(DIAMONDS);
 }
 
 const std::deque<Card*> &StraightsModel::getSpadesPile() const {
-  return spadesPile;
+  return getPileView(SPADES);
 }
 
-std::deque<Card*> &StraightsModel::getPile(const Card &card) const {
-  return pileMap.at(card.getSuit());
+const std::deque<Card*> &StraightsModel::getPileView(const Suit suit) const {
+  const PileBounds pile = piles[suit - 1];
+  if (pileViews.empty()) pileViews.resize(NUM_SUITS);
+  std::deque<Card*> &view = pileViews[suit - 1];
+  view.clear();
+  if (pile.empty()) return view;
+  for (int rank = pile.low; rank <= pile.high; rank++) {
+    view.push_back(deck.getCard(cardIndex(suit, rank)));
+  }
+  return view;
 }
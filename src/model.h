@@ -4,46 +4,121 @@
 /*
 The "model" portion of the MVC architecture. Handles
 game state information.
+
+The board is kept as bitboards (see bitboard.h): each pile is a low/high
+rank pair, each player has a hand mask, and an owner table maps each card
+to the seat holding it. The deque accessors are built from these on demand
+for the View.
+
+Every play and discard in a round is recorded in an undo journal, so
+lookahead can make moves and take them back without copying the model.
+
+The model also keeps a Zobrist hash of the position (see zobrist.h):
+where every card is, the piles and the seat to move. It is updated with
+each change, so hash() is constant time. Debug builds recompute it after
+every change and check that the two agree.
 */
 
 #include <vector>
 #include <memory>
 #include <map>
 #include <deque>
-#include <functional>
+#include <array>
 
 #include "deck.h"
 #include "player.h"
+#include "bitboard.h"
+#include "simstate.h"
+#include "zobrist.h"
 
 class Player;
 class StraightsController;
-class PlayerHandler;
+
+// Told about every play and discard made on a model, for example to
+// record the game
+class GameObserver {
+public:
+  virtual void cardPlayed(int seat, CardId card) = 0;
+  virtual void cardDiscarded(int seat, CardId card) = 0;
+  // The latest play or discard was taken back with unmakeMove
+  virtual void moveUndone() = 0;
+  virtual ~GameObserver() = default;
+};
+
+// A point in the current round that the model can be restored to
+struct ModelSnapshot {
+  size_t journalSize;
+};
 
 class StraightsModel {
-  std::vector<std::unique_ptr<Player>> players;
-  std::deque<Card*> clubsPile;
-  std::deque<Card*> diamondsPile;
-  std::deque<Card*> heartsPile;
-  std::deque<Card*> spadesPile;
-  const std::map<Suit, std::deque<Card*>&> pileMap = {
-    {CLUBS, clubsPile}, {DIAMONDS, diamondsPile},
-    {HEARTS, heartsPile}, {SPADES, spadesPile}
+  // Enough to undo one play or discard
+  struct JournalEntry {
+    uint8_t seat;
+    uint8_t card;
+    bool discard;
+    // Where the card was in the player's hand
+    uint8_t handPosition;
   };
-  std::deque<Card*> &getPile(const Card &card) const;
+  std::vector<JournalEntry> journal;
+  std::vector<std::unique_ptr<Player>> players;
+  // Indexed by suit - 1
+  PileBounds piles[NUM_SUITS];
+  // Index into players of the seat holding each card, or NO_OWNER
+  std::array<int8_t, NUM_CARDS> owner;
+  // Cards that could be played on the piles right now: at most two per
+  // suit, kept up to date as cards are played and taken back
+  CardMask frontier = playableMask(piles);
+  // Sets the frontier of one suit (indexed by suit - 1) from its pile
+  void updateFrontier(int suit);
+  // Cards each seat has discarded this round
+  CardMask discardMasks[NUM_SEATS] = {0, 0, 0, 0};
+  // Seat whose turn it is, or NO_OWNER between rounds
+  int8_t toMove = NO_OWNER;
+  uint64_t positionHash = 0;
+  // Passes the turn to seat, updating the hash
+  void setToMove(int8_t seat);
+  // Seat after the given one in turn order
+  int8_t nextSeat(int seat) const;
+  // Recomputes the hash and checks it against positionHash in debug builds
+  void checkHash() const;
+  // Adapters for the deque accessors, rebuilt from piles when requested.
+  // Empty until first used, since only the View needs them.
+  mutable std::vector<std::deque<Card*>> pileViews;
+  const std::deque<Card*> &getPileView(Suit suit) const;
   Deck deck;
+  GameObserver *observer = nullptr;
 public:
   // Game ends when a player reaches this score;
   static const int MAX_SCORE;
   // Seed will seed the Deck's RNG. If the seed isn't given,
   // or if the seed is DEFAULT_SEED, it's set to the current time by default.
-  StraightsModel(unsigned seed = Deck::DEFAULT_SEED);
+  StraightsModel(unsigned seed = Deck::DEFAULT_SEED,
+                 ShuffleMode mode = ShuffleMode::LEGACY);
   void dealHands();
-  // Loops through all players constantly, and applies the visitor to each
-  // The loop breaks when the Loop Flag on v is set to false.
-  void loopThroughPlayers(Player* start, PlayerHandler& v);
+  // Deals the cards in the given order instead of the deck's shuffle
+  void dealHands(const DeckOrder &order);
+  // Sets up a round part way through, for replays. Each seat is dealt
+  // the cards of order that are in held or that it discarded, in the
+  // order they come, and has its total score set. The (seat, card)
+  // discards are then made again in order, and the piles set as given.
+  // The loaded moves can't be unmade.
+  void loadRound(const DeckOrder &order, const CardMask held[NUM_SEATS],
+                 const std::vector<std::pair<int, CardId>> &discards,
+                 const PileBounds loadedPiles[NUM_SUITS],
+                 const int totalScores[NUM_SEATS]);
+  // Only one observer is kept; nullptr removes it
+  void setObserver(GameObserver *o);
+  // The player in the given seat, in turn order
+  Player &getPlayer(int seat) const;
+  int getPlayerCount() const;
   // A for_each implementation to apply func to all players in the model;
   // Takes in a function with the signature void f(Player &)
-  void forEachPlayer(std::function<void(Player &)> func);
+  template <typename F>
+  void forEachPlayer(F func) {
+    for (auto& p : players) {
+      func(*p);
+    }
+  }
   // Adds a player to the game.
   void addPlayer(std::unique_ptr<Player> p);
   // Replaces player p1 with a new player p2
@@ -53,20 +128,69 @@ public:
   Player* whoHasCard(const Card& card) const;
   // Returns nullptr if no card is found in the deck with the given
   // string representation
-  Card *getCard(std::string rep) const;
+  Card *getCard(const std::string &rep) const;
+  Card *getCard(CardId id) const;
+  // Returns the card with the given index (see Card::getIndex)
+  Card *getCard(int index) const;
+  // Throws InvalidPlay if the card can't be played, or CardNotInHand
+  // if p doesn't hold it.
   void playCard(Player &p, Card& card);
+  // Moves the card from p's hand to their discards
+  void discardCard(Player &p, Card& card);
+  // Plays or discards for p. Throws like playCard.
+  void makeMove(Player &p, SimMove move);
+  // Takes back the latest play or discard of this round, including any
+  // score it added. Does nothing at the start of a round.
+  void unmakeMove();
+  // Plays and discards made this round, not counting loaded ones
+  int getMoveCount() const;
+  // The i'th play or discard of the round. Sets seat to who made it.
+  SimMove getMove(int i, int &seat) const;
+  // Constant time; only valid until the round is reset
+  ModelSnapshot snapshot() const;
+  // Takes back every move made since the snapshot was taken
+  void restore(ModelSnapshot snapshot);
   bool isLegalPlay(const Card& card) const;
   const std::vector<Card*> getLegalPlays(const Player &p) const;
+  // Every card that could be played on the piles. Constant time and
+  // never allocates.
+  CardMask getPlayableMask() const;
+  // The cards of p's hand that could be played, as a mask. Constant time
+  // and never allocates.
+  CardMask getLegalPlayMask(const Player &p) const;
   void shuffleDeck();
+  // Skips the deck's next n shuffles if its shuffle mode can jump ahead
+  // (see Deck::skipShuffles)
+  bool skipShuffles(uint64_t n);
+  // The order the current round was dealt in
+  const DeckOrder &getDealOrder() const;
+  // The deck's seed, with DEFAULT_SEED replaced by the time it used
+  unsigned getSeed() const;
+  ShuffleMode getShuffleMode() const;
+  // Index of p in the turn order, or -1 if p isn't in the game
+  int getSeat(const Player &p) const;
+  // A copy of the round in progress, with p to move
+  SimState getSimState(const Player &p) const;
+  // Constant time key of the position: card locations, piles and the
+  // seat to move. Scores are not included.
+  uint64_t hash() const;
+  // The same key, computed from scratch
+  uint64_t computeHash() const;
   // Checks if players' hands are empty
   bool isEndOfRound() const;
   // Checks if any players score are above MAX_SCORE
   bool isEndOfGame() const;
+  // The lowest total score of any player
+  int getLowestScore() const;
   // Returns players with lowest score
   const std::vector<Player *> getWinners() const;
   // Clears each players' hands, discards, and roundscore (But keeps
   // their total score intact). Also resets deck, and clears the board
   void resetRound();
+  // Starts a new game in place, as a model made with this seed (and the
+  // same shuffle mode) would, keeping the players and their strategies.
+  // Nothing is allocated, so a model can be reused for game after game.
+  void resetGame(unsigned seed);
   // Purey for testing purposes. Prints the deck to stdout
   void printDeck();
   const std::deque<Card*> &getClubsPile() const;
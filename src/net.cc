@@ -0,0 +1,132 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "net.h"
+
+bool parseNetAddress(const std::string &spec, NetAddress &address) {
+  NetAddress parsed;
+  if (spec.compare(0, 5, "unix:") == 0) {
+    parsed.local = true;
+    parsed.path = spec.substr(5);
+    if (parsed.path.empty() ||
+        parsed.path.size() >= sizeof(sockaddr_un::sun_path)) return false;
+  } else if (spec.compare(0, 4, "tcp:") == 0) {
+    std::string rest = spec.substr(4);
+    const size_t colon = rest.rfind(':');
+    if (colon != std::string::npos) {
+      parsed.host = rest.substr(0, colon);
+      rest = rest.substr(colon + 1);
+    }
+    try {
+      size_t used;
+      parsed.port = std::stoi(rest, &used);
+      if (used != rest.size() || parsed.port < 0 || parsed.port > 65535) {
+        return false;
+      }
+    } catch (std::logic_error &e) {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  address = parsed;
+  return true;
+}
+
+std::string netAddressName(const NetAddress &address) {
+  if (address.local) return "unix:" + address.path;
+  return "tcp:" + address.host + ":" + std::to_string(address.port);
+}
+
+void setNonBlocking(const int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    throw SocketError{};
+  }
+}
+
+namespace {
+  // Fills in a sockaddr for the address, returning its length
+  socklen_t makeSockaddr(const NetAddress &address, sockaddr_storage &storage) {
+    std::memset(&storage, 0, sizeof(storage));
+    if (address.local) {
+      sockaddr_un &un = reinterpret_cast<sockaddr_un &>(storage);
+      un.sun_family = AF_UNIX;
+      std::strncpy(un.sun_path, address.path.c_str(), sizeof(un.sun_path) - 1);
+      return sizeof(sockaddr_un);
+    }
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(address.host.c_str(), nullptr, &hints, &found) != 0 ||
+        !found) {
+      throw SocketError{};
+    }
+    sockaddr_in &in = reinterpret_cast<sockaddr_in &>(storage);
+    in = *reinterpret_cast<sockaddr_in *>(found->ai_addr);
+    in.sin_port = htons(address.port);
+    freeaddrinfo(found);
+    return sizeof(sockaddr_in);
+  }
+
+  int makeSocket(const NetAddress &address) {
+    const int fd = socket(address.local ? AF_UNIX : AF_INET,
+                          SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw SocketError{};
+    if (!address.local) {
+      const int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+  }
+}
+
+int listenOn(const NetAddress &address) {
+  sockaddr_storage storage;
+  const socklen_t length = makeSockaddr(address, storage);
+  const int fd = makeSocket(address);
+  const int on = 1;
+  if (address.local) {
+    // A socket file left by an earlier server would make bind fail, but
+    // anything else at the path is never removed
+    struct stat info;
+    if (lstat(address.path.c_str(), &info) == 0 &&
+        (!S_ISSOCK(info.st_mode) || unlink(address.path.c_str()) < 0)) {
+      close(fd);
+      throw SocketError{};
+    }
+  } else {
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  }
+  if (bind(fd, reinterpret_cast<sockaddr *>(&storage), length) < 0 ||
+      listen(fd, SOMAXCONN) < 0) {
+    close(fd);
+    throw SocketError{};
+  }
+  setNonBlocking(fd);
+  return fd;
+}
+
+int connectTo(const NetAddress &address) {
+  sockaddr_storage storage;
+  const socklen_t length = makeSockaddr(address, storage);
+  const int fd = makeSocket(address);
+  setNonBlocking(fd);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&storage), length) < 0 &&
+      errno != EINPROGRESS) {
+    close(fd);
+    throw SocketError{};
+  }
+  return fd;
+}
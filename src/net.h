@@ -0,0 +1,37 @@
+#ifndef _H_NET
+#define _H_NET
+
+/*
+Small helpers for the local sockets used by the game server and the load
+client. Addresses are written as tcp:PORT, tcp:HOST:PORT or unix:PATH.
+All sockets are made non-blocking.
+*/
+
+#include <string>
+
+struct NetAddress {
+  // A Unix-domain socket at path, instead of TCP at host:port
+  bool local = false;
+  std::string host = "127.0.0.1";
+  int port = 0;
+  std::string path;
+};
+
+// Parses an address. Returns false if it isn't one.
+bool parseNetAddress(const std::string &spec, NetAddress &address);
+std::string netAddressName(const NetAddress &address);
+
+// Makes a listening socket. Throws SocketError. A Unix-domain socket
+// replaces a stale socket file at its path, but anything else there is
+// left alone and SocketError thrown.
+int listenOn(const NetAddress &address);
+// Starts connecting a socket, which becomes writable once connected.
+// Throws SocketError.
+int connectTo(const NetAddress &address);
+void setNonBlocking(int fd);
+
+struct SocketError {
+  const char *what() const { return "Socket error"; }
+};
+
+#endif
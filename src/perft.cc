@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+#include "perft.h"
+#include "model.h"
+#include "view.h"
+#include "controller.h"
+#include "player.h"
+#include "threads.h"
+
+// Counted with both generators, which agreed
+const std::vector<PerftReference> PERFT_REFERENCE = {
+  {1, 10, 368819},
+  {3, 12, 249959},
+  {7, 11, 4331470},
+  {42, 12, 70396},
+  {42, 16, 2749801},
+  {12345, 12, 227810},
+};
+
+namespace {
+  // Positions to expand to before counting in parallel, per thread
+  const size_t TASKS_PER_THREAD = 32;
+
+  // Seed and round of the counter shuffle jump-ahead check
+  const unsigned SKIP_CHECK_SEED = 42;
+  const unsigned SKIP_CHECK_ROUND = 5;
+
+  // Shuffles the model's deck for its round'th deal, jumping ahead if
+  // the shuffle mode can
+  void shuffleForRound(StraightsModel &model, const unsigned round) {
+    if (!model.skipShuffles(round)) {
+      for (unsigned i = 0; i < round; i++) {
+        model.shuffleDeck();
+      }
+    }
+    model.shuffleDeck();
+  }
+
+  // A seeded model with four seats, dealt the given round
+  struct DealtTable {
+    StraightsModel model;
+    NullView view;
+    StraightsController controller;
+    int leader = 0;
+
+    DealtTable(const unsigned seed, const ShuffleMode shuffle,
+               const unsigned round) :
+      model{seed, shuffle}, controller{view, model}
+    {
+      controller.initializePlayers("cccc");
+      shuffleForRound(model, round);
+      model.dealHands();
+      const Card &sevenOfSpades = *model.getCard(CardId::of(SPADES, SEVEN));
+      leader = model.getSeat(*model.whoHasCard(sevenOfSpades));
+    }
+  };
+
+  void count(const SimState &state, const int ply, const int depth,
+             uint64_t leaves[]) {
+    const CardMask plays = state.legalPlays();
+    if (ply + 1 == depth) {
+      leaves[depth] += cardCount(plays ? plays : state.hands[state.toMove]);
+      return;
+    }
+    SimMove moves[RANKS_PER_SUIT];
+    const int n = state.legalMoves(moves);
+    leaves[ply + 1] += n;
+    for (int i = 0; i < n; i++) {
+      SimState next = state;
+      next.apply(moves[i]);
+      count(next, ply + 1, depth, leaves);
+    }
+  }
+
+  void countModel(StraightsModel &model, const int toMove, const int ply,
+                  const int depth, uint64_t leaves[]) {
+    Player &p = model.getPlayer(toMove);
+    // As StraightsController::discard allows
+    const bool discarding = model.getLegalPlayMask(p) == 0;
+    for (CardMask hand = p.getHandMask(); hand; hand &= hand - 1) {
+      const int index = lowestCard(hand);
+      if (!discarding && !model.isLegalPlay(*model.getCard(index))) continue;
+      leaves[ply + 1]++;
+      if (ply + 1 == depth) continue;
+      model.makeMove(p, discarding ? discardMove(index) : playMove(index));
+      countModel(model, (toMove + 1) % NUM_SEATS, ply + 1, depth, leaves);
+      model.unmakeMove();
+    }
+  }
+
+  void printCounts(const PerftCounts &counts, std::ostream &out) {
+    for (size_t ply = 1; ply < counts.leaves.size(); ply++) {
+      out << "depth " << ply << ": " << counts.leaves[ply] << std::endl;
+    }
+  }
+}
+
+uint64_t PerftCounts::nodes() const {
+  uint64_t sum = 0;
+  for (const uint64_t n : leaves) sum += n;
+  return sum;
+}
+
+SimState perftStart(const unsigned seed, const ShuffleMode shuffle,
+                    const unsigned round) {
+  const DealtTable table{seed, shuffle, round};
+  return table.model.getSimState(table.model.getPlayer(table.leader));
+}
+
+PerftCounts perft(const SimState &start, int depth, unsigned threads) {
+  depth = std::min(depth, start.cardsLeft());
+  PerftCounts counts;
+  counts.leaves.assign(depth + 1, 0);
+  counts.leaves[0] = 1;
+  threads = resolveThreads(threads);
+
+  // Expands the first plies breadth first. The round can't end before
+  // depth, so every position has a move.
+  std::vector<SimState> tasks{start};
+  int split = 0;
+  while (split + 1 < depth && tasks.size() < threads * TASKS_PER_THREAD) {
+    std::vector<SimState> next;
+    for (const SimState &state : tasks) {
+      SimMove moves[RANKS_PER_SUIT];
+      const int n = state.legalMoves(moves);
+      for (int i = 0; i < n; i++) {
+        next.push_back(state);
+        next.back().apply(moves[i]);
+      }
+    }
+    tasks.swap(next);
+    split++;
+    counts.leaves[split] = tasks.size();
+  }
+  if (split == depth) return counts;
+
+  std::atomic<size_t> nextTask{0};
+  std::vector<std::vector<uint64_t>> workerLeaves(threads,
+                                                  std::vector<uint64_t>(depth + 1, 0));
+  auto worker = [&](std::vector<uint64_t> &leaves) {
+    for (size_t task = nextTask++; task < tasks.size(); task = nextTask++) {
+      count(tasks[task], split, depth, leaves.data());
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; i++) {
+    pool.emplace_back(worker, std::ref(workerLeaves[i]));
+  }
+  worker(workerLeaves[0]);
+  for (auto &t : pool) {
+    t.join();
+  }
+  for (const auto &leaves : workerLeaves) {
+    for (int ply = split + 1; ply <= depth; ply++) {
+      counts.leaves[ply] += leaves[ply];
+    }
+  }
+  return counts;
+}
+
+PerftCounts perftModel(StraightsModel &model, const int toMove, int depth) {
+  int cardsLeft = 0;
+  for (int seat = 0; seat < NUM_SEATS; seat++) {
+    cardsLeft += cardCount(model.getPlayer(seat).getHandMask());
+  }
+  depth = std::min(depth, cardsLeft);
+  PerftCounts counts;
+  counts.leaves.assign(depth + 1, 0);
+  counts.leaves[0] = 1;
+  if (depth > 0) countModel(model, toMove, 0, depth, counts.leaves.data());
+  return counts;
+}
+
+bool runPerft(const PerftConfig &config, std::ostream &out) {
+  DealtTable table{config.seed, config.shuffle, config.round};
+  const SimState start = table.model.getSimState(table.model.getPlayer(table.leader));
+  const unsigned threads = resolveThreads(config.threads);
+
+  const auto begin = std::chrono::steady_clock::now();
+  const PerftCounts counts = perft(start, config.depth, threads);
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - begin;
+
+  out << "seed: " << table.model.getSeed() << std::endl;
+  out << "shuffle: " << shuffleModeName(config.shuffle) << std::endl;
+  out << "round: " << config.round + 1 << std::endl;
+  printCounts(counts, out);
+  out << "leaves: " << counts.leaves.back() << std::endl;
+  out << "nodes: " << counts.nodes() << std::endl;
+  out << "threads: " << threads << std::endl;
+  out << "seconds: " << std::fixed << std::setprecision(3) << elapsed.count() << std::endl;
+  out << "nodes/sec: " << std::setprecision(0)
+      << (elapsed.count() > 0 ? counts.nodes() / elapsed.count() : 0.0) << std::endl;
+  if (!config.verify) return true;
+
+  const auto modelBegin = std::chrono::steady_clock::now();
+  const PerftCounts modelCounts = perftModel(table.model, table.leader, config.depth);
+  const std::chrono::duration<double> modelElapsed =
+    std::chrono::steady_clock::now() - modelBegin;
+  const bool agree = modelCounts.leaves == counts.leaves;
+  out << "model leaves: " << modelCounts.leaves.back()
+      << (agree ? " (agrees)" : " (differs)") << std::endl;
+  out << "model nodes/sec: "
+      << (modelElapsed.count() > 0 ? modelCounts.nodes() / modelElapsed.count() : 0.0)
+      << std::endl;
+  if (!agree) printCounts(modelCounts, out);
+  return agree;
+}
+
+bool checkPerftReference(const unsigned threads, std::ostream &out) {
+  bool passed = true;
+  for (const PerftReference &ref : PERFT_REFERENCE) {
+    const PerftCounts counts =
+      perft(perftStart(ref.seed, ShuffleMode::LEGACY), ref.depth, threads);
+    const bool match = counts.leaves.back() == ref.leaves;
+    out << "seed " << ref.seed << " depth " << ref.depth << ": "
+        << counts.leaves.back();
+    if (match) out << " ok" << std::endl;
+    else out << " (expected " << ref.leaves << ")" << std::endl;
+    passed = passed && match;
+  }
+
+  StraightsModel skipped{SKIP_CHECK_SEED, ShuffleMode::COUNTER};
+  StraightsModel shuffled{SKIP_CHECK_SEED, ShuffleMode::COUNTER};
+  bool jumped = skipped.skipShuffles(SKIP_CHECK_ROUND);
+  skipped.shuffleDeck();
+  for (unsigned i = 0; i <= SKIP_CHECK_ROUND; i++) {
+    shuffled.shuffleDeck();
+  }
+  jumped = jumped && skipped.getDealOrder() == shuffled.getDealOrder();
+  out << "counter seed " << SKIP_CHECK_SEED << " round " << SKIP_CHECK_ROUND + 1
+      << ": " << (jumped ? "ok" : "differs") << std::endl;
+  return passed && jumped;
+}
@@ -0,0 +1,82 @@
+#ifndef _H_PERFT
+#define _H_PERFT
+
+/*
+Perft: counts every sequence of plays and discards from the start of a
+seeded deal to a given depth, as chess engines do to check and time
+their move generators.
+
+Moves come from SimState::legalMoves, which follows the same rules as
+StraightsModel::isLegalPlay and the discard rule of
+StraightsController::discard (a seat may only discard, and then any card
+in hand, when it has nothing to play). With verify, the same counts are
+also made through the model itself, playing and taking back every move
+on its undo journal, and the two must agree.
+
+The tree is expanded a few plies breadth first until there are enough
+positions for every thread to take many, then the threads count below
+them. The counts don't depend on the number of threads. The counts at
+the last depth are taken from the number of legal moves, without
+making them.
+
+PERFT_REFERENCE holds counts for a few seeds and depths, for checking a
+new move generator against.
+*/
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "deck.h"
+#include "simstate.h"
+
+class StraightsModel;
+
+struct PerftConfig {
+  // Depth in plies; every round ends after NUM_CARDS of them
+  int depth = 8;
+  // If the seed is Deck::DEFAULT_SEED, a seed is picked from the current time.
+  unsigned seed = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  // Deal to count from, 0 being the seed's first. The counter shuffle
+  // jumps straight to it; the others shuffle through every earlier round.
+  unsigned round = 0;
+  // 0 uses one thread per hardware core
+  unsigned threads = 0;
+  // Also count through StraightsModel, single threaded
+  bool verify = false;
+};
+
+// Sequences of each length up to a depth; leaves[0] is 1
+struct PerftCounts {
+  std::vector<uint64_t> leaves;
+  // Positions visited, including the start and the leaves
+  uint64_t nodes() const;
+};
+
+// Known counts of the first deal of a seed, with the legacy shuffle
+struct PerftReference {
+  unsigned seed;
+  int depth;
+  uint64_t leaves;
+};
+extern const std::vector<PerftReference> PERFT_REFERENCE;
+
+// The position at the start of the seed's round'th deal (from 0), with
+// the holder of the seven of spades to move
+SimState perftStart(unsigned seed, ShuffleMode shuffle, unsigned round = 0);
+// Counts below start, on the given number of threads
+PerftCounts perft(const SimState &start, int depth, unsigned threads);
+// Counts below the model's position through the model, leaving it as it
+// was. The round must have been dealt, and toMove be the seat to move.
+PerftCounts perftModel(StraightsModel &model, int toMove, int depth);
+
+// Counts the seed's deal and prints the counts and speed to out. Returns
+// false if verify finds a difference.
+bool runPerft(const PerftConfig &config, std::ostream &out);
+// Counts every PERFT_REFERENCE position, and checks that jumping a
+// counter-shuffled deck ahead deals what shuffling through does. Prints
+// each result to out, and returns false if any differs.
+bool checkPerftReference(unsigned threads, std::ostream &out);
+
+#endif
@@ -5,30 +5,54 @@
 #include "controller.h"
 #include "debug.h"
 
+// Most cards a player can hold, or discard, in a round
+const int MAX_HAND_SIZE = 13;
+
 Player::Player(const std::string name) : name{name}
-{}
+{
+  // Reserved up front, so dealing and discarding never allocate
+  hand.reserve(MAX_HAND_SIZE);
+  discards.reserve(MAX_HAND_SIZE);
+}
 
 bool Player::hasCard(const Card& card) const {
-  return std::find(hand.begin(), hand.end(), &card) != hand.end();
+  return handMask & cardBit(card.getIndex());
 }
 
-void Player::removeCard(const Card& card) {
-  auto i = find(hand.begin(), hand.end(), &card);
-  if (i == hand.end()) {
+unsigned Player::removeCard(const Card& card) {
+  if (!hasCard(card)) {
     throw CardNotInHand{};
   }
+  auto i = find(hand.begin(), hand.end(), &card);
+  const unsigned position = i - hand.begin();
   hand.erase(i);
+  handMask &= ~cardBit(card.getIndex());
+  return position;
 }
 
-void Player::discardCard(Card& card) {
-  removeCard(card);
+unsigned Player::discardCard(Card& card) {
+  const unsigned position = removeCard(card);
   discards.push_back(&card);
   roundScore += card.getScore();
   totalScore += card.getScore();
+  return position;
 }
 
 void Player::giveCard(Card& card) {
   hand.push_back(&card);
+  handMask |= cardBit(card.getIndex());
+}
+
+void Player::returnCard(Card& card, const unsigned position) {
+  hand.insert(hand.begin() + position, &card);
+  handMask |= cardBit(card.getIndex());
+}
+
+void Player::undoDiscard(Card& card, const unsigned position) {
+  discards.pop_back();
+  roundScore -= card.getScore();
+  totalScore -= card.getScore();
+  returnCard(card, position);
 }
 
 int Player::getRoundScore() const {
@@ -40,7 +64,7 @@ int Player::getTotalScore() const {
 }
 
 
-std::string Player::getName() const {
+const std::string &Player::getName() const {
   return name;
 }
 
@@ -49,16 +73,30 @@ const std::vector<Card*> &Player::getHand() const {
   return hand;
 }
 
+CardMask Player::getHandMask() const {
+  return handMask;
+}
+
 const std::vector<Card*> &Player::getDiscards() const {
   return discards;
 }
 
 void Player::reset() {
   hand.clear();
+  handMask = 0;
   discards.clear();
   roundScore = 0;
 }
 
+void Player::reset(const int newTotalScore) {
+  reset();
+  totalScore = newTotalScore;
+}
+
+void Player::resetGame() {
+  reset(0);
+}
+
 HumanPlayer::HumanPlayer(const std::string name) : Player{name}
 {}
 
@@ -75,6 +113,15 @@ void ComputerPlayer::accept(PlayerHandler &v) {
   v.handlePlayer(*this);
 }
 
+void ComputerPlayer::resetGame() {
+  Player::resetGame();
+  turnStrat->resetGame();
+}
+
 void ComputerPlayer::doTurn() {
   turnStrat->doTurn(*this);
 }
+
+void ComputerPlayer::addStrategyStats(StrategyStats &stats) const {
+  turnStrat->addStats(stats);
+}
@@ -10,14 +10,20 @@ Can be either a human player, or an AI ComputerPlayer
 #include <vector>
 #include <memory>
 
+#include "bitboard.h"
+
 class Card;
 class PlayerHandler;
 class StraightsModel;
 class TurnStrategy;
+struct StrategyStats;
 
 class Player {
   const std::string name;
+  // Cards in the order they were given, for display and strategies
   std::vector<Card*> hand;
+  // The same cards as hand, as a set for constant time lookups
+  CardMask handMask = 0;
   std::vector<Card*> discards;
   int roundScore = 0;
   int totalScore = 0;
@@ -25,16 +31,28 @@ public:
   Player(std::string name);
   // Searches Player's hand (not discard pile)
   bool hasCard(const Card& card) const;
-  void removeCard(const Card& card);
-  void discardCard(Card& card);
+  // Returns the position the card had in the hand
+  unsigned removeCard(const Card& card);
+  // Returns the position the card had in the hand
+  unsigned discardCard(Card& card);
   void giveCard(Card& card);
+  // Undoes removeCard, putting the card back at its old position
+  void returnCard(Card& card, unsigned position);
+  // Undoes the latest discardCard, which must have been of this card,
+  // including its score
+  void undoDiscard(Card& card, unsigned position);
   int calculateScore();
   // Clears hands, discards, and roundScore
   void reset();
+  // Like reset, but also sets the total score
+  void reset(int newTotalScore);
+  // Clears everything for a new game, keeping the hand and discard buffers
+  virtual void resetGame();
   int getRoundScore() const;
   int getTotalScore() const;
-  std::string getName() const;
+  const std::string &getName() const;
   const std::vector<Card*> &getHand() const;
+  CardMask getHandMask() const;
   const std::vector<Card*> &getDiscards() const;
   // Implementation of Visitor Pattern
   virtual void accept(PlayerHandler &v) = 0;
@@ -54,7 +72,11 @@ public:
   // Requires a move of a unique_ptr<TurnStrategy> to transfer ownership
   ComputerPlayer(std::string name, std::unique_ptr<TurnStrategy> strat);
   void accept(PlayerHandler &v) override;
+  // Also resets the strategy
+  void resetGame() override;
   void doTurn();
+  // Adds what the strategy has done to stats
+  void addStrategyStats(StrategyStats &stats) const;
 };
 
 #endif
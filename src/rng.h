@@ -0,0 +1,141 @@
+#ifndef _H_RNG
+#define _H_RNG
+
+/*
+Small, fast random number generators for shuffling. Each one satisfies
+the standard UniformRandomBitGenerator requirements, so they can also be
+used with the <random> and <algorithm> facilities.
+*/
+
+#include <cstdint>
+#include <limits>
+
+// SplitMix64, used to expand a seed into a generator's state
+inline constexpr uint64_t splitMix64(uint64_t &state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// xoshiro256** by Blackman and Vigna
+class Xoshiro256 {
+  uint64_t s[4];
+  static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+public:
+  typedef uint64_t result_type;
+  explicit Xoshiro256(uint64_t seed) {
+    for (uint64_t &word : s) {
+      word = splitMix64(seed);
+    }
+  }
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return std::numeric_limits<uint64_t>::max(); }
+  result_type operator()() {
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+  // Equivalent to 2^128 calls, to split off non-overlapping sequences
+  void jump() {
+    static const uint64_t JUMP[] = {
+      0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+      0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    uint64_t t[4] = {0, 0, 0, 0};
+    for (uint64_t word : JUMP) {
+      for (int b = 0; b < 64; b++) {
+        if (word & (uint64_t{1} << b)) {
+          for (int i = 0; i < 4; i++) t[i] ^= s[i];
+        }
+        (*this)();
+      }
+    }
+    for (int i = 0; i < 4; i++) s[i] = t[i];
+  }
+};
+
+// PCG32 (XSH RR) by O'Neill
+class Pcg32 {
+  static const uint64_t MULTIPLIER = 6364136223846793005ULL;
+  uint64_t state;
+  uint64_t increment;
+public:
+  typedef uint32_t result_type;
+  explicit Pcg32(uint64_t seed, uint64_t stream = 0xda3e39cb94b95bdbULL) :
+    state{0}, increment{(stream << 1) | 1}
+  {
+    (*this)();
+    state += seed;
+    (*this)();
+  }
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+  result_type operator()() {
+    const uint64_t old = state;
+    state = old * MULTIPLIER + increment;
+    const uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+    const uint32_t rot = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+  }
+  // Skips ahead delta calls in O(log delta)
+  void advance(uint64_t delta) {
+    uint64_t curMult = MULTIPLIER, curPlus = increment;
+    uint64_t accMult = 1, accPlus = 0;
+    while (delta > 0) {
+      if (delta & 1) {
+        accMult *= curMult;
+        accPlus = accPlus * curMult + curPlus;
+      }
+      curPlus = (curMult + 1) * curPlus;
+      curMult *= curMult;
+      delta >>= 1;
+    }
+    state = accMult * state + accPlus;
+  }
+};
+
+// A counter-based generator: the n'th output is a hash of the key and n,
+// so it can jump to any position in constant time.
+class CounterRng {
+  uint64_t key;
+  uint64_t counter = 0;
+public:
+  typedef uint64_t result_type;
+  explicit CounterRng(uint64_t seed) : key{seed * 0xD1B54A32D192ED03ULL} {}
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return std::numeric_limits<uint64_t>::max(); }
+  result_type operator()() {
+    uint64_t x = key + counter++ * 0x9E3779B97F4A7C15ULL;
+    return splitMix64(x);
+  }
+  void discard(uint64_t n) { counter += n; }
+  void seek(uint64_t position) { counter = position; }
+  uint64_t position() const { return counter; }
+};
+
+// A uniformly random number in [0, bound) using Lemire's multiply and
+// shift method, which almost never needs a division
+template <typename Rng>
+uint32_t boundedRandom(Rng &rng, uint32_t bound) {
+  uint64_t m = static_cast<uint64_t>(static_cast<uint32_t>(rng())) * bound;
+  uint32_t low = static_cast<uint32_t>(m);
+  if (low < bound) {
+    const uint32_t threshold = -bound % bound;
+    while (low < threshold) {
+      m = static_cast<uint64_t>(static_cast<uint32_t>(rng())) * bound;
+      low = static_cast<uint32_t>(m);
+    }
+  }
+  return m >> 32;
+}
+
+#endif
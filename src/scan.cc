@@ -0,0 +1,487 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+#include "scan.h"
+#include "cardid.h"
+#include "debug.h"
+#include "threads.h"
+
+namespace {
+  const char *const SUIT_WORDS[NUM_SUITS] = {"clubs", "diamonds", "hearts", "spades"};
+  const char *const RANK_WORDS[RANKS_PER_SUIT] = {
+    "aces", "twos", "threes", "fours", "fives", "sixes", "sevens",
+    "eights", "nines", "tens", "jacks", "queens", "kings"
+  };
+
+  // What can be played right after the seven of spades is led
+  const CardMask AFTER_LEAD = cardBit(cardIndex(CLUBS, SEVEN)) |
+    cardBit(cardIndex(DIAMONDS, SEVEN)) | cardBit(cardIndex(HEARTS, SEVEN)) |
+    cardBit(cardIndex(SPADES, SIX)) | cardBit(cardIndex(SPADES, EIGHT));
+
+  bool isOperatorChar(const char c) {
+    return c == '=' || c == '!' || c == '<' || c == '>';
+  }
+
+  int points(CardMask hand) {
+    int sum = 0;
+    for (; hand; hand &= hand - 1) sum += rankOfIndex(lowestCard(hand));
+    return sum;
+  }
+
+  // minstd_rand0, which std::default_random_engine is
+  const uint64_t MINSTD_MODULUS = 2147483647;
+  const uint64_t MINSTD_MULTIPLIER = 16807;
+  // max() - min() of its outputs, which run from 1 to MINSTD_MODULUS - 1
+  const uint32_t MINSTD_RANGE = MINSTD_MODULUS - 2;
+
+  inline uint32_t minstdNext(const uint32_t x) {
+    // The modulus is 2^31 - 1, so the high bits fold back onto the low
+    const uint64_t product = x * MINSTD_MULTIPLIER;
+    uint64_t folded = (product & MINSTD_MODULUS) + (product >> 31);
+    if (folded >= MINSTD_MODULUS) folded -= MINSTD_MODULUS;
+    return folded;
+  }
+
+  // Division and remainder of 32-bit numbers by a divisor d of at least
+  // 2, through reciprocal(d). Exact for every 32-bit n (Lemire, Kaser
+  // and Kurz, "Faster remainder by direct computation").
+  inline uint64_t reciprocal(const uint32_t d) {
+    return UINT64_MAX / d + 1;
+  }
+
+  inline uint32_t divide(const uint32_t n, const uint64_t reciprocal) {
+    return (static_cast<unsigned __int128>(reciprocal) * n) >> 64;
+  }
+
+  inline uint32_t remainder(const uint32_t n, const uint64_t reciprocal,
+                            const uint32_t d) {
+    const uint64_t low = reciprocal * n;
+    return (static_cast<unsigned __int128>(low) * d) >> 64;
+  }
+
+  // Standard order, which every new Deck starts from
+  void resetOrder(DeckOrder &order) {
+    for (int i = 0; i < NUM_CARDS; i++) order[i] = i;
+  }
+
+  // Seeds a worker claims at a time
+  const uint64_t CHUNK = 1 << 14;
+}
+
+class PredicateParser {
+  std::vector<std::string> tokens;
+  size_t next = 0;
+  DealPredicate &predicate;
+
+  bool accept(const char *word) {
+    if (next < tokens.size() && tokens[next] == word) {
+      next++;
+      return true;
+    }
+    return false;
+  }
+
+  const std::string &take() {
+    if (next >= tokens.size()) throw InvalidPredicate{};
+    return tokens[next++];
+  }
+
+  int add(const DealPredicate::Node &node) {
+    predicate.nodes.push_back(node);
+    return predicate.nodes.size() - 1;
+  }
+
+  int join(const DealPredicate::Test test, const int left, const int right) {
+    DealPredicate::Node node;
+    node.test = test;
+    node.left = left;
+    node.right = right;
+    return add(node);
+  }
+
+  int parseSeat(const std::string &word) {
+    if (word == "any") return DealPredicate::ANY_SEAT;
+    if (word == "all") return DealPredicate::ALL_SEATS;
+    if (word == "leader") return DealPredicate::LEADER;
+    if (word == "next") return DealPredicate::NEXT;
+    if (word.size() == 2 && word[0] == 'p' && word[1] >= '1' &&
+        word[1] < '1' + NUM_SEATS) {
+      return word[1] - '1';
+    }
+    throw InvalidPredicate{};
+  }
+
+  CardMask parseCards(const std::string &word) {
+    CardMask cards = 0;
+    size_t start = 0;
+    while (start <= word.size()) {
+      size_t end = word.find(',', start);
+      if (end == std::string::npos) end = word.size();
+      const std::string item = word.substr(start, end - start);
+      CardMask mask = 0;
+      for (int suit = 1; suit <= NUM_SUITS; suit++) {
+        if (item == SUIT_WORDS[suit - 1]) mask = suitMask(suit);
+      }
+      for (int rank = 1; rank <= RANKS_PER_SUIT; rank++) {
+        if (item != RANK_WORDS[rank - 1]) continue;
+        for (int suit = 1; suit <= NUM_SUITS; suit++) {
+          mask |= cardBit(cardIndex(suit, rank));
+        }
+      }
+      if (mask == 0) {
+        const CardId card = parseCardId(item.data(), item.size());
+        if (!card.valid()) throw InvalidPredicate{};
+        mask = card.bit();
+      }
+      cards |= mask;
+      start = end + 1;
+    }
+    return cards;
+  }
+
+  void parseComparison(DealPredicate::Node &node) {
+    const std::string &op = take();
+    if (op == "==") node.compare = DealPredicate::Compare::EQ;
+    else if (op == "!=") node.compare = DealPredicate::Compare::NE;
+    else if (op == "<") node.compare = DealPredicate::Compare::LT;
+    else if (op == "<=") node.compare = DealPredicate::Compare::LE;
+    else if (op == ">") node.compare = DealPredicate::Compare::GT;
+    else if (op == ">=") node.compare = DealPredicate::Compare::GE;
+    else throw InvalidPredicate{};
+    const std::string &number = take();
+    if (number.empty() || number.size() > 3 ||
+        number.find_first_not_of("0123456789") != std::string::npos) {
+      throw InvalidPredicate{};
+    }
+    node.value = std::stoi(number);
+  }
+
+  int parseTest() {
+    DealPredicate::Node node;
+    node.seat = parseSeat(take());
+    const std::string &word = take();
+    if (word == "has") {
+      node.test = DealPredicate::Test::HAS;
+      node.cards = parseCards(take());
+    } else if (word == "holds") {
+      node.test = DealPredicate::Test::HOLDS;
+      node.cards = parseCards(take());
+      parseComparison(node);
+    } else if (word == "points") {
+      node.test = DealPredicate::Test::POINTS;
+      parseComparison(node);
+    } else if (word == "stuck") {
+      node.test = DealPredicate::Test::STUCK;
+    } else {
+      throw InvalidPredicate{};
+    }
+    return add(node);
+  }
+
+  int parseFactor() {
+    if (accept("not")) return join(DealPredicate::Test::NOT, parseFactor(), -1);
+    if (accept("(")) {
+      const int inner = parsePredicate();
+      if (!accept(")")) throw InvalidPredicate{};
+      return inner;
+    }
+    return parseTest();
+  }
+
+  int parseTerm() {
+    int left = parseFactor();
+    while (accept("and")) left = join(DealPredicate::Test::AND, left, parseFactor());
+    return left;
+  }
+
+  int parsePredicate() {
+    int left = parseTerm();
+    while (accept("or")) left = join(DealPredicate::Test::OR, left, parseTerm());
+    return left;
+  }
+
+public:
+  PredicateParser(const std::string &text, DealPredicate &predicate) :
+    predicate{predicate}
+  {
+    // Words are split at spaces, around parentheses, and around runs of
+    // comparison characters
+    size_t i = 0;
+    while (i < text.size()) {
+      const char c = text[i];
+      size_t end = i + 1;
+      if (std::isspace(static_cast<unsigned char>(c))) {
+        i++;
+        continue;
+      } else if (isOperatorChar(c)) {
+        while (end < text.size() && isOperatorChar(text[end])) end++;
+      } else if (c != '(' && c != ')') {
+        while (end < text.size() && !std::isspace(static_cast<unsigned char>(text[end])) &&
+               text[end] != '(' && text[end] != ')' && !isOperatorChar(text[end])) {
+          end++;
+        }
+      }
+      tokens.push_back(text.substr(i, end - i));
+      i = end;
+    }
+  }
+
+  void parse() {
+    predicate.root = parsePredicate();
+    if (next != tokens.size()) throw InvalidPredicate{};
+  }
+};
+
+DealPredicate::DealPredicate(const std::string &text) {
+  PredicateParser{text, *this}.parse();
+}
+
+bool DealPredicate::testSeat(const Node &n, const CardMask hand) const {
+  int value = 0;
+  switch (n.test) {
+    case Test::HAS:
+      return (hand & n.cards) == n.cards;
+    case Test::STUCK:
+      return (hand & AFTER_LEAD) == 0;
+    case Test::HOLDS:
+      value = cardCount(hand & n.cards);
+      break;
+    case Test::POINTS:
+      value = points(hand);
+      break;
+    default:
+      return false;
+  }
+  switch (n.compare) {
+    case Compare::EQ: return value == n.value;
+    case Compare::NE: return value != n.value;
+    case Compare::LT: return value < n.value;
+    case Compare::LE: return value <= n.value;
+    case Compare::GT: return value > n.value;
+    case Compare::GE: return value >= n.value;
+  }
+  return false;
+}
+
+bool DealPredicate::evaluate(const int node, const CardMask hands[NUM_SEATS],
+                             const int leader) const {
+  const Node &n = nodes[node];
+  switch (n.test) {
+    case Test::AND:
+      return evaluate(n.left, hands, leader) && evaluate(n.right, hands, leader);
+    case Test::OR:
+      return evaluate(n.left, hands, leader) || evaluate(n.right, hands, leader);
+    case Test::NOT:
+      return !evaluate(n.left, hands, leader);
+    default:
+      break;
+  }
+  switch (n.seat) {
+    case ANY_SEAT:
+      for (int seat = 0; seat < NUM_SEATS; seat++) {
+        if (testSeat(n, hands[seat])) return true;
+      }
+      return false;
+    case ALL_SEATS:
+      for (int seat = 0; seat < NUM_SEATS; seat++) {
+        if (!testSeat(n, hands[seat])) return false;
+      }
+      return true;
+    case LEADER:
+      return testSeat(n, hands[leader]);
+    case NEXT:
+      return testSeat(n, hands[(leader + 1) % NUM_SEATS]);
+    default:
+      return testSeat(n, hands[n.seat]);
+  }
+}
+
+bool DealPredicate::matches(const CardMask hands[NUM_SEATS]) const {
+  const CardMask sevenOfSpades = cardBit(cardIndex(SPADES, SEVEN));
+  int leader = 0;
+  while (!(hands[leader] & sevenOfSpades)) leader++;
+  return evaluate(root, hands, leader);
+}
+
+bool DealPredicate::matches(const DeckOrder &order) const {
+  CardMask hands[NUM_SEATS] = {0, 0, 0, 0};
+  for (int i = 0; i < NUM_CARDS; i++) {
+    hands[i / RANKS_PER_SUIT] |= cardBit(order[i]);
+  }
+  return matches(hands);
+}
+
+LegacyDealer::LegacyDealer() {
+  // libstdc++'s std::shuffle of an even number of cards swaps the second
+  // card with one of the first two, then swaps the rest in pairs, each
+  // pair from a single draw below (i + 1) * (i + 2)
+  for (int k = 0; k < NUM_CARDS / 2; k++) {
+    const uint32_t first = k == 0 ? 2 : 2 * k + 1;
+    const uint32_t second = k == 0 ? 1 : 2 * k + 2;
+    const uint32_t range = first * second;
+    // std::uniform_int_distribution scales a draw down by dividing it,
+    // rejecting the draws at or past the last whole multiple of range
+    const uint32_t scale = MINSTD_RANGE / range;
+    Draw &d = draws[k];
+    d.limit = range * scale;
+    d.scale = reciprocal(scale);
+    d.secondRange = second;
+    d.second = second > 1 ? reciprocal(second) : 0;
+  }
+}
+
+void LegacyDealer::deal(const unsigned seeds[LANES], DeckOrder orders[LANES]) const {
+  uint32_t x[LANES];
+  for (int lane = 0; lane < LANES; lane++) {
+    // As std::linear_congruential_engine::seed does
+    x[lane] = seeds[lane] % MINSTD_MODULUS;
+    if (x[lane] == 0) x[lane] = 1;
+    resetOrder(orders[lane]);
+  }
+  for (int pass = 0; pass < LegacyShuffle::PASSES; pass++) {
+    for (int lane = 0; lane < LANES; lane++) {
+      uint32_t r;
+      do {
+        x[lane] = minstdNext(x[lane]);
+        r = x[lane] - 1;
+      } while (r >= draws[0].limit);
+      std::swap(orders[lane][1], orders[lane][divide(r, draws[0].scale)]);
+    }
+    for (int k = 1; k < NUM_CARDS / 2; k++) {
+      const Draw &d = draws[k];
+      // The lanes are independent, so their work overlaps
+      for (int lane = 0; lane < LANES; lane++) {
+        uint32_t r;
+        do {
+          x[lane] = minstdNext(x[lane]);
+          r = x[lane] - 1;
+        } while (r >= d.limit);
+        const uint32_t both = divide(r, d.scale);
+        DeckOrder &order = orders[lane];
+        std::swap(order[2 * k], order[divide(both, d.second)]);
+        std::swap(order[2 * k + 1], order[remainder(both, d.second, d.secondRange)]);
+      }
+    }
+  }
+}
+
+bool LegacyDealer::verify() const {
+  // Includes the seeds that wrap around minstd_rand0's modulus
+  const unsigned samples[] = {
+    1, 2, 3, 7, 42, 12345, 65535, 1000003, 2147483646, 2147483647,
+    2147483648u, 4294967294u, 4294967295u, 3141592653u, 2718281828u, 99
+  };
+  const int count = sizeof(samples) / sizeof(samples[0]);
+  for (int first = 0; first < count; first += LANES) {
+    DeckOrder fast[LANES];
+    deal(&samples[first], fast);
+    for (int lane = 0; lane < LANES; lane++) {
+      LegacyShuffle engine{samples[first + lane]};
+      DeckOrder order;
+      resetOrder(order);
+      engine.shuffle(order);
+      if (order != fast[lane]) return false;
+    }
+  }
+  return true;
+}
+
+void runScan(const ScanConfig &config, std::ostream &out) {
+  const DealPredicate predicate{config.predicate};
+  const unsigned threads = resolveThreads(config.threads);
+  const LegacyDealer dealer;
+  const bool fast = config.shuffle == ShuffleMode::LEGACY && dealer.verify();
+  if (config.shuffle == ShuffleMode::LEGACY && !fast) {
+    Debug::print("LegacyDealer disagrees with LegacyShuffle; using LegacyShuffle");
+  }
+  // Seeds past the last unsigned can't be dealt
+  const uint64_t end = std::min<uint64_t>(uint64_t{config.seed} + config.seeds,
+                                          uint64_t{UINT32_MAX} + 1);
+  const uint64_t total = end - config.seed;
+
+  // Workers claim chunks of seeds in order, and once enough matches are
+  // found stop claiming more. Every claimed chunk is finished, so the
+  // seeds scanned are always a prefix of the range.
+  std::atomic<uint64_t> nextChunk{0};
+  std::atomic<uint64_t> found{0};
+  std::vector<std::vector<unsigned>> workerMatches(threads);
+  auto worker = [&](std::vector<unsigned> &matches) {
+    std::unique_ptr<ShuffleEngine> engine;
+    if (!fast) engine = makeShuffleEngine(config.shuffle, config.seed);
+    while (config.matches == 0 || found < config.matches) {
+      const uint64_t first = config.seed + nextChunk.fetch_add(1) * CHUNK;
+      if (first >= end) return;
+      const uint64_t last = std::min(first + CHUNK, end);
+      uint64_t seed = first;
+      if (fast) {
+        unsigned seeds[LegacyDealer::LANES];
+        DeckOrder orders[LegacyDealer::LANES];
+        for (; seed + LegacyDealer::LANES <= last; seed += LegacyDealer::LANES) {
+          for (int lane = 0; lane < LegacyDealer::LANES; lane++) {
+            seeds[lane] = seed + lane;
+          }
+          dealer.deal(seeds, orders);
+          for (int lane = 0; lane < LegacyDealer::LANES; lane++) {
+            if (seeds[lane] == Deck::DEFAULT_SEED) continue;
+            if (predicate.matches(orders[lane])) {
+              matches.push_back(seeds[lane]);
+              found++;
+            }
+          }
+        }
+        // The few seeds left over are dealt by the engine below
+        if (seed < last) engine = makeShuffleEngine(config.shuffle, config.seed);
+      }
+      DeckOrder order;
+      for (; seed < last; seed++) {
+        if (seed == Deck::DEFAULT_SEED) continue;
+        engine->reseed(seed);
+        resetOrder(order);
+        engine->shuffle(order);
+        if (predicate.matches(order)) {
+          matches.push_back(seed);
+          found++;
+        }
+      }
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; i++) {
+    pool.emplace_back(worker, std::ref(workerMatches[i]));
+  }
+  worker(workerMatches[0]);
+  for (auto &t : pool) {
+    t.join();
+  }
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  std::vector<unsigned> matches;
+  for (const auto &m : workerMatches) {
+    matches.insert(matches.end(), m.begin(), m.end());
+  }
+  std::sort(matches.begin(), matches.end());
+  if (config.matches > 0 && matches.size() > config.matches) {
+    matches.resize(config.matches);
+  }
+  // Every claimed chunk was scanned, up to the end of the range
+  const uint64_t scanned = std::min(nextChunk.load() * CHUNK, total);
+
+  out << "predicate: " << config.predicate << std::endl;
+  out << "shuffle: " << shuffleModeName(config.shuffle) << std::endl;
+  for (const unsigned seed : matches) {
+    out << "match: " << seed << std::endl;
+  }
+  out << "seeds: " << scanned << std::endl;
+  out << "matches: " << matches.size() << std::endl;
+  out << "threads: " << threads << std::endl;
+  out << "seconds: " << std::fixed << std::setprecision(3) << elapsed.count() << std::endl;
+  out << "seeds/sec: " << std::setprecision(1)
+      << (elapsed.count() > 0 ? scanned / elapsed.count() : 0.0) << std::endl;
+}
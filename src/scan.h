@@ -0,0 +1,127 @@
+#ifndef _H_SCAN
+#define _H_SCAN
+
+/*
+Searches the seed space for deals with given properties, for writing
+regression scenarios and studying edge cases.
+
+Only the first shuffle and deal of each seed is made, exactly as a new
+StraightsModel with that seed would make them, without the model,
+players or strategies. Every shuffle mode but legacy runs its
+ShuffleEngine directly. The legacy shuffle (100 std::shuffle passes) is
+made by LegacyDealer, which runs libstdc++'s std::shuffle algorithm over
+minstd_rand0 with every division by a loop constant turned into a
+multiplication, several seeds at a time. It's checked against
+LegacyShuffle before each scan, and LegacyShuffle is used instead should
+they ever disagree, for example with another standard library.
+
+Deals are matched against a DealPredicate, written in a small language
+over the four hands dealt:
+
+  pred   := term ("or" term)*
+  term   := factor ("and" factor)*
+  factor := "not" factor | "(" pred ")" | test
+  test   := SEAT "has" CARDS          holds every card of CARDS
+          | SEAT "holds" CARDS OP N   holds OP N of the cards of CARDS
+          | SEAT "points" OP N        ranks in hand add up to OP N
+          | SEAT "stuck"              can't play if it moves right after
+                                      7S is led: holds no 7C 7D 7H 6S 8S
+  SEAT   := p1 | p2 | p3 | p4 | leader (holds 7S) | next (moves after
+            the leader) | any | all
+  CARDS  := cards (7S, 10H), suits (hearts) and ranks (sevens), joined
+            by commas
+  OP     := == | != | < | <= | > | >=
+
+For example "p1 has sevens" or "next stuck and leader points < 60".
+*/
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "bitboard.h"
+#include "deck.h"
+#include "simstate.h"
+
+class DealPredicate {
+  enum class Test { AND, OR, NOT, HAS, HOLDS, POINTS, STUCK };
+  enum class Compare { EQ, NE, LT, LE, GT, GE };
+  struct Node {
+    Test test;
+    // Operands of AND, OR and NOT
+    int left = -1;
+    int right = -1;
+    // A seat from 0 to 3, or one of the seat words below
+    int seat = 0;
+    CardMask cards = 0;
+    Compare compare = Compare::EQ;
+    int value = 0;
+  };
+  std::vector<Node> nodes;
+  int root = -1;
+  friend class PredicateParser;
+  bool evaluate(int node, const CardMask hands[NUM_SEATS], int leader) const;
+  // Tests one seat
+  bool testSeat(const Node &n, CardMask hand) const;
+public:
+  static const int ANY_SEAT = NUM_SEATS;
+  static const int ALL_SEATS = NUM_SEATS + 1;
+  static const int LEADER = NUM_SEATS + 2;
+  static const int NEXT = NUM_SEATS + 3;
+  // Throws InvalidPredicate if text isn't in the language above
+  explicit DealPredicate(const std::string &text);
+  // Seat i is dealt order[13 * i] to order[13 * i + 12]
+  bool matches(const DeckOrder &order) const;
+  bool matches(const CardMask hands[NUM_SEATS]) const;
+};
+
+// Makes the first legacy shuffle of a seed far faster than LegacyShuffle
+class LegacyDealer {
+  // One draw of std::shuffle: a uniform number below range, found by
+  // dividing a draw from minstd_rand0 below limit by scale
+  struct Draw {
+    uint32_t limit;
+    uint64_t scale;
+    // For dividing by the second swap's range
+    uint64_t second;
+    uint32_t secondRange;
+  };
+  Draw draws[NUM_CARDS / 2];
+public:
+  // Seeds dealt at once, to keep the processor busy
+  static const int LANES = 4;
+  LegacyDealer();
+  // Writes the order a LegacyShuffle with each seed makes on its first
+  // shuffle of a new deck into orders
+  void deal(const unsigned seeds[LANES], DeckOrder orders[LANES]) const;
+  // True if the deals agree with LegacyShuffle for a sample of seeds
+  bool verify() const;
+};
+
+struct ScanConfig {
+  std::string predicate;
+  // Seeds from seed to seed + seeds - 1 are scanned. Deck::DEFAULT_SEED is
+  // skipped, as a Deck would use the time instead.
+  unsigned seed = 1;
+  uint64_t seeds = 1000000;
+  // Stops once this many seeds have matched, and prints the lowest;
+  // 0 finds every match
+  uint64_t matches = 10;
+  // 0 uses one thread per hardware core
+  unsigned threads = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+};
+
+// Scans the seeds, and prints the matching ones and the speed to out.
+// Throws InvalidPredicate if config.predicate can't be parsed.
+void runScan(const ScanConfig &config, std::ostream &out);
+
+// Exceptions
+struct InvalidPredicate: public std::exception {
+  const char* what() {
+    return "The deal predicate could not be parsed.";
+  }
+};
+
+#endif
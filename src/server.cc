@@ -0,0 +1,632 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <unordered_map>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+#include "server.h"
+#include "model.h"
+#include "player.h"
+#include "view.h"
+#include "tournament.h"
+#include "simstate.h"
+#include "debug.h"
+#include "threads.h"
+
+namespace {
+  const size_t READ_CHUNK = 4096;
+  // Clients this far behind on reading their output, or this far ahead
+  // on typing, are disconnected
+  const size_t MAX_PENDING_OUTPUT = 1 << 20;
+  const size_t MAX_PENDING_INPUT = 1 << 16;
+  const int MAX_EVENTS = 256;
+
+  struct Table;
+
+  // One connection, shared by the event loop and the workers playing its
+  // table
+  struct Session {
+    const int fd;
+    const uint64_t id;
+    std::mutex mutex;
+    // Read from the socket but not yet taken by the table
+    std::string input;
+    // Printed by the table but not yet written to the socket
+    std::string output;
+    // Only used by the event loop: the table it's playing at, if any
+    std::weak_ptr<Table> table;
+    // The connection is gone; the table sees the end of its input
+    bool closed = false;
+    // The table is over, so close once the output is written
+    bool finished = false;
+    // Waiting for the event loop to write the output
+    bool flushQueued = false;
+    // Only used by the event loop: waiting for the socket to be writable
+    bool writing = false;
+    Session(const int fd, const uint64_t id) : fd{fd}, id{id} {}
+  };
+
+  class Server;
+
+  // Buffers what a view prints until publish() hands it to the event
+  // loop, so a whole step of a table is sent at once. Input is never read
+  // through it: the table takes what players type from their sessions.
+  class SessionBuf: public std::streambuf {
+    std::shared_ptr<Session> session;
+    Server &server;
+    std::string pending;
+  protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+  public:
+    SessionBuf(std::shared_ptr<Session> session, Server &server) :
+      session{std::move(session)}, server{server}
+    {}
+    void publish();
+  };
+
+  // Built before the TextView that prints to it
+  struct SessionStream {
+    SessionBuf buf;
+    std::iostream stream;
+    SessionStream(std::shared_ptr<Session> session, Server &server) :
+      buf{std::move(session), server}, stream{&buf}
+    {}
+  };
+
+  // A TextView over one connection
+  class SessionView: private SessionStream, public TextView {
+  public:
+    SessionView(std::shared_ptr<Session> session, Server &server) :
+      SessionStream{std::move(session), server}, TextView{stream, stream}
+    {}
+    void flush() {
+      buf.publish();
+    }
+  };
+
+  // Shows a table's game to each of its connections. What everyone
+  // would see at the table is sent to all of them, and the board, hand
+  // and prompts only to the player whose turn it is.
+  class TableView: public View {
+    std::vector<std::unique_ptr<SessionView>> seats;
+    std::vector<std::string> names;
+    SessionView *active = nullptr;
+    SessionView &current() {
+      return active ? *active : *seats[0];
+    }
+  public:
+    void addSeat(const std::string &name, std::unique_ptr<SessionView> seat) {
+      names.push_back(name);
+      seats.push_back(std::move(seat));
+    }
+    void beginTurn(const std::string &playerName) override {
+      for (size_t i = 0; i < seats.size(); i++) {
+        if (names[i] == playerName) active = seats[i].get();
+      }
+    }
+    void displayBoard(const std::deque<Card*>& clubs, const std::deque<Card*>& diamonds,
+                      const std::deque<Card*>& hearts, const std::deque<Card*>& spades) override {
+      current().displayBoard(clubs, diamonds, hearts, spades);
+    }
+    void displayHand(const std::vector<Card*>& hand) override {
+      current().displayHand(hand);
+    }
+    void displayLegalPlays(const std::vector<Card*>& legalPlays) override {
+      current().displayLegalPlays(legalPlays);
+    }
+    void displayMessage(const std::string &msg) override {
+      for (auto &seat : seats) seat->displayMessage(msg);
+    }
+    void displayError(const std::string &err) override {
+      current().displayError(err);
+    }
+    void displayMove(const std::string &playerName, const Card &card,
+                     const bool discard) override {
+      for (auto &seat : seats) seat->displayMove(playerName, card, discard);
+    }
+    // Tables never prompt: they ask with showPrompt, and their input
+    // comes from the sessions
+    std::string promptCardSelection(std::string) override {
+      return "";
+    }
+    std::string promptCommand() override {
+      return "ragequit";
+    }
+    // Shows the prompt TextView would, to the player whose turn it is
+    void showPrompt(const InputRequest request) {
+      if (request == InputRequest::COMMAND) current().displayCommandPrompt();
+      else if (request == InputRequest::CARD) current().displayMessage("");
+    }
+    void displayScore(std::string playerName, const std::vector<Card*>& discards,
+                      const int oldScore, const int newScore) override {
+      for (auto &seat : seats) {
+        seat->displayScore(playerName, discards, oldScore, newScore);
+      }
+    }
+    void displayWin(std::string playerName) override {
+      for (auto &seat : seats) seat->displayWin(playerName);
+    }
+    void flush() {
+      for (auto &seat : seats) seat->flush();
+    }
+  };
+
+  // A game in progress, played a step at a time by whichever worker
+  // picks it up
+  struct Table {
+    uint64_t id;
+    // The connection of each human seat, and its player's name
+    std::vector<std::shared_ptr<Session>> sessions;
+    std::vector<std::string> names;
+    // Held by the worker stepping the table
+    std::mutex mutex;
+    // Guarded by the server's pool mutex: waiting in the pool's queue
+    bool queued = false;
+    std::atomic<bool> done{false};
+    // Made by the first step
+    std::unique_ptr<StraightsModel> model;
+    std::unique_ptr<TableView> view;
+    std::unique_ptr<StraightsController> controller;
+  };
+
+  class Server {
+    const ServerConfig &config;
+    std::ostream &log;
+    unsigned seed;
+    size_t humans = 0;
+    int epollFd = -1;
+    // Written to wake the event loop from a worker
+    int wakeFd = -1;
+    std::vector<int> listeners;
+    // Socket files this server made, removed again when it stops
+    struct SocketFile {
+      std::string path;
+      dev_t device;
+      ino_t inode;
+    };
+    std::vector<SocketFile> socketFiles;
+    std::unordered_map<int, std::shared_ptr<Session>> sessions;
+    // Connected, but not at a table yet
+    std::vector<std::shared_ptr<Session>> waiting;
+    std::list<std::shared_ptr<Table>> tables;
+    uint64_t sessionsAccepted = 0;
+    uint64_t tablesStarted = 0;
+    uint64_t tablesFinished = 0;
+    // Sessions with output to write, queued by the workers
+    std::mutex dirtyMutex;
+    std::vector<std::shared_ptr<Session>> dirty;
+    // Tables with something to do, waiting for a worker
+    std::vector<std::thread> workers;
+    std::mutex poolMutex;
+    std::condition_variable poolReady;
+    std::deque<std::shared_ptr<Table>> ready;
+    bool stopping = false;
+
+    void watch(int fd, uint32_t events, int op);
+    void acceptAll(int listener);
+    void readAll(const std::shared_ptr<Session> &session);
+    void flush(const std::shared_ptr<Session> &session);
+    void closeSession(const std::shared_ptr<Session> &session);
+    void startTable();
+    // Has a worker step the table
+    void schedule(const std::shared_ptr<Table> &table);
+    void work();
+    // Plays the table until it waits for a player who hasn't typed
+    // anything yet, or it's over
+    void stepTable(Table &table);
+    void beginTable(Table &table);
+    // Takes the next word typed by the player the table is waiting on.
+    // Returns false if they haven't typed a whole one yet.
+    bool takeInput(Table &table, InputRequest request, std::string &word);
+    void finishTable(Table &table);
+    void reapTables();
+    bool finished() const;
+  public:
+    Server(const ServerConfig &config, std::ostream &log);
+    ~Server();
+    void run();
+    // Called from a worker with what one of its views printed
+    void send(const std::shared_ptr<Session> &session, const std::string &data);
+    void wake();
+  };
+
+  SessionBuf::int_type SessionBuf::overflow(const int_type c) {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      pending += traits_type::to_char_type(c);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize SessionBuf::xsputn(const char *s, const std::streamsize n) {
+    pending.append(s, n);
+    return n;
+  }
+
+  void SessionBuf::publish() {
+    if (!pending.empty()) {
+      server.send(session, pending);
+      pending.clear();
+    }
+  }
+
+  Server::Server(const ServerConfig &config, std::ostream &log) :
+    config{config}, log{log}, seed{config.seed}
+  {
+    for (const char type : config.players) {
+      if (type == 'h') humans++;
+      else if (!StraightsController::isComputerType(type)) throw InvalidPlayerType{};
+    }
+    if (config.players.size() != NUM_SEATS || humans == 0) throw InvalidPlayerType{};
+    if (seed == Deck::DEFAULT_SEED) {
+      seed = std::chrono::system_clock::now().time_since_epoch().count();
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) throw SocketError{};
+    watch(wakeFd, EPOLLIN, EPOLL_CTL_ADD);
+    for (const NetAddress &address : config.addresses) {
+      listeners.push_back(listenOn(address));
+      watch(listeners.back(), EPOLLIN, EPOLL_CTL_ADD);
+      struct stat info;
+      if (address.local && lstat(address.path.c_str(), &info) == 0) {
+        socketFiles.push_back(SocketFile{address.path, info.st_dev, info.st_ino});
+      }
+      log << "listening on " << netAddressName(address) << std::endl;
+    }
+    const unsigned threads = resolveThreads(config.threads);
+    for (unsigned i = 0; i < threads; i++) {
+      workers.emplace_back(&Server::work, this);
+    }
+  }
+
+  Server::~Server() {
+    {
+      std::lock_guard<std::mutex> lock{poolMutex};
+      stopping = true;
+    }
+    poolReady.notify_all();
+    for (auto &worker : workers) worker.join();
+    while (!sessions.empty()) closeSession(sessions.begin()->second);
+    for (const int fd : listeners) close(fd);
+    // Only if the path is still the socket this server bound
+    for (const SocketFile &file : socketFiles) {
+      struct stat info;
+      if (lstat(file.path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode) &&
+          info.st_dev == file.device && info.st_ino == file.inode) {
+        unlink(file.path.c_str());
+      }
+    }
+    if (wakeFd >= 0) close(wakeFd);
+    if (epollFd >= 0) close(epollFd);
+  }
+
+  void Server::watch(const int fd, const uint32_t events, const int op) {
+    epoll_event event;
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, op, fd, &event) < 0) throw SocketError{};
+  }
+
+  void Server::wake() {
+    const uint64_t one = 1;
+    while (write(wakeFd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+  }
+
+  void Server::send(const std::shared_ptr<Session> &session,
+                    const std::string &data) {
+    {
+      std::lock_guard<std::mutex> lock{session->mutex};
+      if (session->closed) return;
+      session->output += data;
+      if (session->flushQueued) return;
+      session->flushQueued = true;
+    }
+    {
+      std::lock_guard<std::mutex> lock{dirtyMutex};
+      dirty.push_back(session);
+    }
+    wake();
+  }
+
+  void Server::acceptAll(const int listener) {
+    while (true) {
+      const int fd = accept4(listener, nullptr, nullptr,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) return;
+      const int on = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      auto session = std::make_shared<Session>(fd, ++sessionsAccepted);
+      sessions[fd] = session;
+      watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+      waiting.push_back(session);
+      Debug::print("Accepted connection " + std::to_string(session->id));
+      if (waiting.size() >= humans) startTable();
+      else send(session, "Waiting for more players to join...\n");
+    }
+  }
+
+  void Server::readAll(const std::shared_ptr<Session> &session) {
+    char buffer[READ_CHUNK];
+    while (true) {
+      const ssize_t n = recv(session->fd, buffer, sizeof(buffer), 0);
+      if (n > 0) {
+        bool ahead;
+        {
+          std::lock_guard<std::mutex> lock{session->mutex};
+          session->input.append(buffer, n);
+          ahead = session->input.size() > MAX_PENDING_INPUT;
+        }
+        if (ahead) {
+          log << "connection " << session->id << " disconnected: typed "
+              << MAX_PENDING_INPUT << " bytes ahead" << std::endl;
+          closeSession(session);
+          return;
+        }
+        if (auto table = session->table.lock()) schedule(table);
+        continue;
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+      }
+      closeSession(session);
+      return;
+    }
+  }
+
+  void Server::flush(const std::shared_ptr<Session> &session) {
+    std::unique_lock<std::mutex> lock{session->mutex};
+    session->flushQueued = false;
+    if (session->closed) return;
+    size_t written = 0;
+    bool failed = false;
+    while (written < session->output.size()) {
+      const ssize_t n = ::send(session->fd, session->output.data() + written,
+                               session->output.size() - written, MSG_NOSIGNAL);
+      if (n > 0) {
+        written += n;
+      } else if (n < 0 && errno == EINTR) {
+        continue;
+      } else {
+        failed = !(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+        break;
+      }
+    }
+    session->output.erase(0, written);
+    const bool behind = session->output.size() > MAX_PENDING_OUTPUT;
+    const bool done = session->output.empty() && session->finished;
+    const bool wantWrite = !session->output.empty();
+    lock.unlock();
+    if (failed || behind || done) {
+      closeSession(session);
+      return;
+    }
+    if (wantWrite != session->writing) {
+      session->writing = wantWrite;
+      watch(session->fd, EPOLLIN | EPOLLRDHUP | (wantWrite ? EPOLLOUT : 0),
+            EPOLL_CTL_MOD);
+    }
+  }
+
+  void Server::closeSession(const std::shared_ptr<Session> &session) {
+    {
+      std::lock_guard<std::mutex> lock{session->mutex};
+      if (session->closed) return;
+      session->closed = true;
+      session->output.clear();
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, session->fd, nullptr);
+    close(session->fd);
+    sessions.erase(session->fd);
+    for (auto it = waiting.begin(); it != waiting.end(); ++it) {
+      if (*it == session) {
+        waiting.erase(it);
+        break;
+      }
+    }
+    // Its table may be waiting on it, for a computer to take over
+    if (auto table = session->table.lock()) schedule(table);
+    Debug::print("Closed connection " + std::to_string(session->id));
+  }
+
+  void Server::startTable() {
+    if (config.tables > 0 && tablesStarted >= config.tables) return;
+    auto table = std::make_shared<Table>();
+    table->id = tablesStarted++;
+    for (size_t seat = 0; seat < config.players.size(); seat++) {
+      if (config.players[seat] != 'h') continue;
+      table->names.push_back("Player" + std::to_string(seat + 1));
+    }
+    table->sessions.assign(waiting.begin(), waiting.begin() + humans);
+    waiting.erase(waiting.begin(), waiting.begin() + humans);
+    for (auto &session : table->sessions) session->table = table;
+    tables.push_back(table);
+    schedule(table);
+  }
+
+  void Server::schedule(const std::shared_ptr<Table> &table) {
+    {
+      std::lock_guard<std::mutex> lock{poolMutex};
+      if (table->queued) return;
+      table->queued = true;
+      ready.push_back(table);
+    }
+    poolReady.notify_one();
+  }
+
+  void Server::work() {
+    while (true) {
+      std::shared_ptr<Table> table;
+      {
+        std::unique_lock<std::mutex> lock{poolMutex};
+        poolReady.wait(lock, [this]() { return stopping || !ready.empty(); });
+        if (stopping) return;
+        table = std::move(ready.front());
+        ready.pop_front();
+        // Input arriving from now on queues it again
+        table->queued = false;
+      }
+      std::lock_guard<std::mutex> lock{table->mutex};
+      stepTable(*table);
+    }
+  }
+
+  void Server::beginTable(Table &table) {
+    table.model = std::make_unique<StraightsModel>(
+      deriveGameSeed(seed, table.id), config.shuffle);
+    table.view = std::make_unique<TableView>();
+    for (size_t i = 0; i < table.sessions.size(); i++) {
+      table.view->addSeat(table.names[i],
+        std::make_unique<SessionView>(table.sessions[i], *this));
+    }
+    table.controller = std::make_unique<StraightsController>(
+      *table.view, *table.model, config.strategies);
+    table.controller->initializePlayers(config.players);
+    table.view->displayMessage("Table " + std::to_string(table.id + 1) +
+                               " is starting. Players: " + config.players);
+    table.controller->beginGame();
+  }
+
+  void Server::stepTable(Table &table) {
+    if (table.done) return;
+    InputRequest request;
+    if (!table.controller) {
+      beginTable(table);
+      request = table.controller->advance();
+      if (request != InputRequest::NONE) table.view->showPrompt(request);
+    } else {
+      request = table.controller->waitingFor();
+    }
+    std::string word;
+    while (request != InputRequest::NONE &&
+           takeInput(table, request, word)) {
+      request = table.controller->input(word);
+      if (request != InputRequest::NONE) table.view->showPrompt(request);
+    }
+    if (request == InputRequest::NONE) finishTable(table);
+    else table.view->flush();
+  }
+
+  bool Server::takeInput(Table &table, const InputRequest request,
+                         std::string &word) {
+    const std::string &name = table.controller->getWaitingPlayer()->getName();
+    size_t i = 0;
+    while (table.names[i] != name) i++;
+    Session &session = *table.sessions[i];
+    std::lock_guard<std::mutex> lock{session.mutex};
+    const std::string &input = session.input;
+    const char *const SPACE = " \t\r\n\v\f";
+    const size_t start = input.find_first_not_of(SPACE);
+    if (start == std::string::npos) {
+      session.input.clear();
+      if (!session.closed) return false;
+      // A computer takes over from a player who has disconnected
+      word = request == InputRequest::COMMAND ? "ragequit" : "";
+      return true;
+    }
+    const size_t end = input.find_first_of(SPACE, start);
+    // The rest of the word may still be on its way
+    if (end == std::string::npos && !session.closed) return false;
+    word = input.substr(start, end - start);
+    session.input.erase(0, end);
+    return true;
+  }
+
+  void Server::finishTable(Table &table) {
+    table.view->displayMessage("The game is over.");
+    table.view->flush();
+    for (auto &session : table.sessions) {
+      {
+        std::lock_guard<std::mutex> lock{session->mutex};
+        session->finished = true;
+      }
+      // Makes sure the event loop looks at it, even with no output left
+      send(session, std::string{});
+    }
+    table.done = true;
+    wake();
+  }
+
+  void Server::reapTables() {
+    for (auto it = tables.begin(); it != tables.end();) {
+      Table &table = **it;
+      if (!table.done) {
+        ++it;
+        continue;
+      }
+      tablesFinished++;
+      log << "table " << table.id + 1 << " finished (" << tablesFinished
+          << " done, " << tables.size() - 1 << " playing)" << std::endl;
+      it = tables.erase(it);
+    }
+  }
+
+  bool Server::finished() const {
+    // Every connection left is waiting for a table that won't start
+    return config.tables > 0 && tablesFinished >= config.tables &&
+           sessions.size() == waiting.size();
+  }
+
+  void Server::run() {
+    epoll_event events[MAX_EVENTS];
+    while (!finished()) {
+      const int n = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        throw SocketError{};
+      }
+      for (int i = 0; i < n; i++) {
+        const int fd = events[i].data.fd;
+        if (fd == wakeFd) {
+          uint64_t count;
+          while (read(wakeFd, &count, sizeof(count)) > 0) {}
+          continue;
+        }
+        bool isListener = false;
+        for (const int listener : listeners) {
+          if (fd == listener) {
+            acceptAll(fd);
+            isListener = true;
+          }
+        }
+        if (isListener) continue;
+        auto found = sessions.find(fd);
+        if (found == sessions.end()) continue;
+        // Held, since closing it erases it from sessions
+        const std::shared_ptr<Session> session = found->second;
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+          readAll(session);
+        }
+        if (!session->closed && (events[i].events & EPOLLOUT)) flush(session);
+      }
+      // Write out whatever the tables printed since the last pass
+      std::vector<std::shared_ptr<Session>> toFlush;
+      {
+        std::lock_guard<std::mutex> lock{dirtyMutex};
+        toFlush.swap(dirty);
+      }
+      for (auto &session : toFlush) flush(session);
+      reapTables();
+    }
+  }
+}
+
+void runServer(const ServerConfig &config, std::ostream &log) {
+  Server server{config, log};
+  server.run();
+}
@@ -0,0 +1,54 @@
+#ifndef _H_SERVER
+#define _H_SERVER
+
+/*
+Hosts many games at once for players connecting over TCP or Unix-domain
+sockets.
+
+One epoll event loop does all the socket I/O: it accepts connections,
+reads what players type and writes out what their views print, never
+blocking on any one client. Each connection is a human seat, shown the
+same text a TextView would show. Once enough players are waiting to fill
+the human seats of a table, its game starts.
+
+Games never block waiting for input. A table is only handed to one of a
+small, fixed pool of worker threads when the player it waits on has typed
+something, and the worker runs it (and any computer turns after) until it
+waits again. So thousands of tables only need a few threads, and a slow
+or silent client only holds up its own table.
+
+A player who disconnects is taken over by a computer, like ragequit.
+*/
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "deck.h"
+#include "controller.h"
+#include "net.h"
+
+struct ServerConfig {
+  std::vector<NetAddress> addresses;
+  // One character per seat of every table. Each 'h' seat is taken by a
+  // connection, and the others are computer players.
+  std::string players = "hccc";
+  // Table i is dealt from deriveGameSeed(seed, i). If the seed is
+  // Deck::DEFAULT_SEED, a seed is picked from the current time.
+  unsigned seed = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  StrategyOptions strategies;
+  // Stops once this many tables have finished; 0 serves forever
+  uint64_t tables = 0;
+  // Worker threads playing the tables; 0 uses one per hardware core
+  unsigned threads = 0;
+};
+
+// Serves games until config.tables have finished, logging connections
+// and tables to log.
+// Throws SocketError if an address can't be listened on, and
+// InvalidPlayerType if config.players isn't a valid table.
+void runServer(const ServerConfig &config, std::ostream &log);
+
+#endif
@@ -0,0 +1,11 @@
+#include "simcore.h"
+#include "model.h"
+#include "controller.h"
+
+GameResult playCoreGame(const std::string &players, const unsigned seed,
+                        const ShuffleMode shuffle) {
+  if (players != "cccc") throw InvalidPlayerType{};
+  SimCore<NullCoreView, SimplePolicy, SimplePolicy, SimplePolicy, SimplePolicy>
+    core{seed, shuffle};
+  return core.playGame(StraightsModel::MAX_SCORE);
+}
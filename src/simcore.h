@@ -0,0 +1,159 @@
+#ifndef _H_SIMCORE
+#define _H_SIMCORE
+
+/*
+A game core for simulation builds, with the seats and view chosen at
+compile time. Each seat is a strategy policy type and the view is a view
+policy type, so a turn is a plain (usually inlined) call instead of the
+Player::accept, TurnStrategy::doTurn and View virtual calls of the MVC
+path. With four SimplePolicy seats and a NullCoreView the whole game
+compiles down to one loop over SimState.
+
+Deals come from the same Deck, and SimplePolicy makes the same choices as
+SimpleStrategy, so a core game has the same result as the same game
+played through StraightsController. The MVC path is still used for
+interactive play.
+
+A strategy policy has
+  SimMove choose(const CoreRound &round, int seat);
+which must return a legal move for the seat to move, and a view policy has
+  void move(int seat, SimMove move);
+  void roundOver(const int penalties[NUM_SEATS], const int totals[NUM_SEATS]);
+*/
+
+#include <tuple>
+#include <string>
+#include <type_traits>
+
+#include "deck.h"
+#include "simstate.h"
+#include "simulation.h"
+#include "trace.h"
+
+// The round being played: its state, and the order it was dealt in,
+// which is also the order of each seat's hand
+struct CoreRound {
+  SimState state;
+  DeckOrder deal;
+  // Cards of the seat's hand, in the order SimpleStrategy sees them
+  template <typename F>
+  void forEachInHand(int seat, F func) const {
+    const CardMask hand = state.hands[seat];
+    for (int i = seat * RANKS_PER_SUIT; i < (seat + 1) * RANKS_PER_SUIT; i++) {
+      if (hand & cardBit(deal[i])) {
+        if (!func(deal[i])) return;
+      }
+    }
+  }
+};
+
+// Plays the first legal card in hand order, otherwise discards the first
+// card in hand, like SimpleStrategy
+struct SimplePolicy {
+  SimMove choose(const CoreRound &round, const int seat) const {
+    const CardMask legal = round.state.legalPlays();
+    SimMove move = NO_MOVE;
+    round.forEachInHand(seat, [legal, &move](int card) {
+      if (legal) {
+        if (!(legal & cardBit(card))) return true;
+        move = playMove(card);
+      } else {
+        move = discardMove(card);
+      }
+      return false;
+    });
+    return move;
+  }
+};
+
+// Shows nothing
+struct NullCoreView {
+  void move(int, SimMove) {}
+  void roundOver(const int[NUM_SEATS], const int[NUM_SEATS]) {}
+};
+
+template <class ViewPolicy, class... Seats>
+class SimCore {
+  static_assert(sizeof...(Seats) == NUM_SEATS, "SimCore needs one policy per seat");
+  Deck deck;
+  ViewPolicy view;
+  std::tuple<Seats...> seats;
+  CoreRound round;
+  int totals[NUM_SEATS] = {0, 0, 0, 0};
+  unsigned rounds = 0;
+
+  // Asks the policy of the given seat for its move, choosing the policy
+  // by comparing against each seat index in turn
+  template <size_t I>
+  SimMove choose(const int seat, std::integral_constant<size_t, I>) {
+    if (seat == static_cast<int>(I)) return std::get<I>(seats).choose(round, I);
+    return choose(seat, std::integral_constant<size_t, I + 1>{});
+  }
+  SimMove choose(int, std::integral_constant<size_t, NUM_SEATS>) {
+    return NO_MOVE;
+  }
+
+public:
+  explicit SimCore(unsigned seed, ShuffleMode mode = ShuffleMode::LEGACY) :
+    deck{seed, mode}
+  {}
+  // For policies that carry state
+  SimCore(unsigned seed, ShuffleMode mode, ViewPolicy view, Seats... seats) :
+    deck{seed, mode}, view{view}, seats{seats...}
+  {}
+
+  // Shuffles, deals and plays one round
+  void playRound() {
+    TraceScope trace{TraceSpan::ROUND};
+    deck.shuffle();
+    round.deal = deck.getOrder();
+    round.state = SimState{};
+    for (int i = 0; i < NUM_CARDS; i++) {
+      round.state.hands[i / RANKS_PER_SUIT] |= cardBit(round.deal[i]);
+    }
+    const CardMask sevenOfSpades = cardBit(cardIndex(SPADES, SEVEN));
+    while (!(round.state.hands[round.state.toMove] & sevenOfSpades)) {
+      round.state.toMove++;
+    }
+    for (int turn = 0; turn < NUM_CARDS; turn++) {
+      const int seat = round.state.toMove;
+      const SimMove move = choose(seat, std::integral_constant<size_t, 0>{});
+      view.move(seat, move);
+      round.state.apply(move);
+    }
+    for (int seat = 0; seat < NUM_SEATS; seat++) {
+      totals[seat] += round.state.penalties[seat];
+    }
+    view.roundOver(round.state.penalties, totals);
+    rounds++;
+  }
+
+  // Plays rounds until someone reaches maxScore, and picks the winners the way StraightsModel::getWinners does
+  GameResult playGame(int maxScore) {
+    while (true) {
+      playRound();
+      bool over = false;
+      for (const int total : totals) over = over || total >= maxScore;
+      if (over) break;
+    }
+    int lowest = maxScore;
+    for (const int total : totals) {
+      if (total < lowest) lowest = total;
+    }
+    GameResult result;
+    result.rounds = rounds;
+    for (const int total : totals) {
+      result.scores.push_back(total);
+      result.won.push_back(total == lowest);
+    }
+    return result;
+  }
+};
+
+// Plays one game on the template core. Only the seat combinations
+// instantiated in simcore.cc are available ("cccc"); throws
+// InvalidPlayerType for anything else.
+GameResult playCoreGame(const std::string &players, unsigned seed,
+                        ShuffleMode shuffle = ShuffleMode::LEGACY);
+
+#endif
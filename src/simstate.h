@@ -0,0 +1,82 @@
+#ifndef _H_SIMSTATE
+#define _H_SIMSTATE
+
+/*
+A small, copyable snapshot of a round in progress, for strategies that
+play out many hypothetical continuations. It has no pointers and does no
+allocation, so copying one is just a memcpy.
+
+Legality comes from the same bitboard rules as StraightsModel::isLegalPlay.
+*/
+
+#include <cstdint>
+
+#include "bitboard.h"
+
+// Number of seats at the table
+const int NUM_SEATS = 4;
+
+// A play or discard of one card. Discards have the DISCARD bit set.
+typedef uint8_t SimMove;
+const SimMove DISCARD = 0x40;
+const SimMove NO_MOVE = 0xFF;
+
+inline constexpr SimMove playMove(int card) { return card; }
+inline constexpr SimMove discardMove(int card) { return card | DISCARD; }
+inline constexpr int moveCard(SimMove move) { return move & ~DISCARD; }
+inline constexpr bool isDiscard(SimMove move) { return move & DISCARD; }
+
+struct SimState {
+  CardMask hands[NUM_SEATS] = {0, 0, 0, 0};
+  // Indexed by suit - 1
+  PileBounds piles[NUM_SUITS];
+  // Points discarded by each seat this round
+  int penalties[NUM_SEATS] = {0, 0, 0, 0};
+  // Seat whose turn it is
+  uint8_t toMove = 0;
+
+  CardMask playable() const {
+    return playableMask(piles);
+  }
+  // Cards the seat to move may play
+  CardMask legalPlays() const {
+    return hands[toMove] & playable();
+  }
+  bool isRoundOver() const {
+    return (hands[0] | hands[1] | hands[2] | hands[3]) == 0;
+  }
+  int cardsLeft() const {
+    return cardCount(hands[0] | hands[1] | hands[2] | hands[3]);
+  }
+  // Plays or discards for the seat to move, and passes the turn on.
+  // The move must be legal.
+  void apply(SimMove move) {
+    const int card = moveCard(move);
+    hands[toMove] &= ~cardBit(card);
+    if (isDiscard(move)) {
+      penalties[toMove] += rankOfIndex(card);
+    } else {
+      PileBounds &pile = piles[suitOfIndex(card) - 1];
+      const uint8_t rank = rankOfIndex(card);
+      if (pile.empty()) pile.low = pile.high = rank;
+      else if (rank < pile.low) pile.low = rank;
+      else pile.high = rank;
+    }
+    toMove = (toMove + 1) % NUM_SEATS;
+  }
+  // Writes the legal moves of the seat to move into moves, and returns
+  // how many there are. Discards are only legal when nothing can be played.
+  int legalMoves(SimMove moves[RANKS_PER_SUIT]) const {
+    int n = 0;
+    CardMask legal = legalPlays();
+    const bool discarding = legal == 0;
+    if (discarding) legal = hands[toMove];
+    for (; legal; legal &= legal - 1) {
+      const int card = lowestCard(legal);
+      moves[n++] = discarding ? discardMove(card) : playMove(card);
+    }
+    return n;
+  }
+};
+
+#endif
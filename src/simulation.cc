@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+
+#include "simulation.h"
+#include "model.h"
+#include "view.h"
+#include "controller.h"
+#include "deck.h"
+#include "debug.h"
+#include "gamerecord.h"
+#include "simcore.h"
+#include "batchsim.h"
+#include "alloccount.h"
+#include "player.h"
+
+const int SimulationStats::BUCKET_WIDTH = 10;
+
+namespace {
+  // Visits each player to total up the strategies' stats
+  class StrategyStatsCollector: public PlayerHandler {
+    StrategyStats &stats;
+  public:
+    explicit StrategyStatsCollector(StrategyStats &stats) : stats{stats} {}
+    void handlePlayer(HumanPlayer &) override {}
+    void handlePlayer(ComputerPlayer &p) override {
+      p.addStrategyStats(stats);
+    }
+  };
+}
+
+void SimulationStats::add(const GameResult &result) {
+  const unsigned seats = result.scores.size();
+  if (scoreSums.size() < seats) {
+    scoreSums.resize(seats, 0);
+    minScores.resize(seats, StraightsModel::MAX_SCORE);
+    maxScores.resize(seats, 0);
+    wins.resize(seats, 0);
+    ties.resize(seats, 0);
+    scoreBuckets.resize(seats);
+  }
+  const unsigned winners = std::count(result.won.begin(), result.won.end(), true);
+  for (unsigned i = 0; i < seats; i++) {
+    const int score = result.scores[i];
+    scoreSums[i] += score;
+    minScores[i] = std::min(minScores[i], score);
+    maxScores[i] = std::max(maxScores[i], score);
+    if (result.won[i]) {
+      if (winners == 1) wins[i]++;
+      else ties[i]++;
+    }
+    const unsigned bucket = score / BUCKET_WIDTH;
+    if (scoreBuckets[i].size() <= bucket) scoreBuckets[i].resize(bucket + 1, 0);
+    scoreBuckets[i][bucket]++;
+  }
+  games++;
+  rounds += result.rounds;
+}
+
+void SimulationStats::merge(const SimulationStats &other) {
+  const unsigned seats = other.scoreSums.size();
+  if (scoreSums.size() < seats) {
+    scoreSums.resize(seats, 0);
+    minScores.resize(seats, StraightsModel::MAX_SCORE);
+    maxScores.resize(seats, 0);
+    wins.resize(seats, 0);
+    ties.resize(seats, 0);
+    scoreBuckets.resize(seats);
+  }
+  for (unsigned i = 0; i < seats; i++) {
+    scoreSums[i] += other.scoreSums[i];
+    minScores[i] = std::min(minScores[i], other.minScores[i]);
+    maxScores[i] = std::max(maxScores[i], other.maxScores[i]);
+    wins[i] += other.wins[i];
+    ties[i] += other.ties[i];
+    const auto &buckets = other.scoreBuckets[i];
+    if (scoreBuckets[i].size() < buckets.size()) {
+      scoreBuckets[i].resize(buckets.size(), 0);
+    }
+    for (unsigned b = 0; b < buckets.size(); b++) {
+      scoreBuckets[i][b] += buckets[b];
+    }
+  }
+  games += other.games;
+  rounds += other.rounds;
+}
+
+unsigned long long SimulationStats::getGames() const {
+  return games;
+}
+
+void SimulationStats::print(std::ostream &out, const double seconds) const {
+  out << "games: " << games << std::endl;
+  out << "rounds: " << rounds << std::endl;
+  out << "seconds: " << std::fixed << std::setprecision(3) << seconds << std::endl;
+  out << "games/sec: " << std::setprecision(1)
+      << (seconds > 0 ? games / seconds : 0.0) << std::endl;
+  if (games == 0) return;
+  for (unsigned i = 0; i < scoreSums.size(); i++) {
+    out << "seat " << i + 1 << ": wins " << wins[i] << " ties " << ties[i]
+        << " mean " << std::setprecision(2)
+        << static_cast<double>(scoreSums[i]) / games
+        << " min " << minScores[i] << " max " << maxScores[i] << std::endl;
+    out << "  distribution:";
+    for (unsigned b = 0; b < scoreBuckets[i].size(); b++) {
+      out << " [" << b * BUCKET_WIDTH << "," << (b + 1) * BUCKET_WIDTH
+          << "):" << scoreBuckets[i][b];
+    }
+    out << std::endl;
+  }
+}
+
+void checkHeadlessPlayers(const std::string &players) {
+  for (const char type : players) {
+    if (!StraightsController::isComputerType(type)) throw InvalidPlayerType{};
+  }
+}
+
+HeadlessGame::HeadlessGame(const std::string &players,
+                           const ShuffleMode shuffle,
+                           const StrategyOptions &strategies) :
+  heapBefore{AllocCounter::liveBytes()}, model{Deck::DEFAULT_SEED, shuffle},
+  controller{view, model, strategies}
+{
+  checkHeadlessPlayers(players);
+  controller.initializePlayers(players);
+}
+
+void HeadlessGame::play(const unsigned seed, GameResult &result) {
+  controller.resetGame(seed);
+  controller.playGame();
+  // Buffers and tables made during the first game are kept for the rest
+  if (memory == 0) memory = sizeof(*this) + (AllocCounter::liveBytes() - heapBefore);
+
+  result.rounds = controller.getRoundsPlayed();
+  result.scores.clear();
+  result.won.clear();
+  // The winners are the players with the lowest score, as in getWinners
+  const int lowest = model.getLowestScore();
+  model.forEachPlayer([&result, lowest](Player &p) {
+    result.scores.push_back(p.getTotalScore());
+    result.won.push_back(p.getTotalScore() == lowest);
+  });
+}
+
+void HeadlessGame::setRecorder(GameRecorder *recorder) {
+  controller.setRecorder(recorder);
+}
+
+void HeadlessGame::setAllocStats(AllocStats *stats) {
+  controller.setAllocStats(stats);
+}
+
+size_t HeadlessGame::getMemory() const {
+  return memory;
+}
+
+void HeadlessGame::addStrategyStats(StrategyStats &stats) {
+  StrategyStatsCollector collector{stats};
+  model.forEachPlayer([&collector](Player &p) { p.accept(collector); });
+}
+
+GameResult playHeadlessGame(const std::string &players, const unsigned seed,
+                            const ShuffleMode shuffle,
+                            const StrategyOptions &strategies,
+                            GameRecorder *recorder,
+                            AllocStats *allocStats) {
+  HeadlessGame game{players, shuffle, strategies};
+  game.setRecorder(recorder);
+  game.setAllocStats(allocStats);
+  GameResult result;
+  game.play(seed, result);
+  return result;
+}
+
+bool runSimulation(const SimulationConfig &config, std::ostream &out) {
+  unsigned seed = config.seed;
+  if (seed == Deck::DEFAULT_SEED) {
+    seed = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+  Debug::print("Simulation seed: " + std::to_string(seed));
+  SimulationStats stats;
+  std::unique_ptr<RecordWriter> writer;
+  std::unique_ptr<GameRecorder> recorder;
+  if (!config.recordPath.empty()) {
+    writer = std::make_unique<RecordWriter>(config.recordPath);
+    recorder = std::make_unique<GameRecorder>(*writer);
+  }
+  AllocStats allocStats;
+  const bool countAllocations = config.allocReport || config.assertZeroAlloc;
+  std::unique_ptr<BatchSimulator> batch;
+  if (config.batch) batch = std::make_unique<BatchSimulator>(config.shuffle);
+  std::unique_ptr<HeadlessGame> game;
+  if (!config.batch && !config.core) {
+    game = std::make_unique<HeadlessGame>(config.players, config.shuffle,
+                                          config.strategies);
+    game->setRecorder(recorder.get());
+    game->setAllocStats(countAllocations ? &allocStats : nullptr);
+  }
+  GameResult result;
+  std::vector<unsigned> batchSeeds;
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < config.games; i++) {
+    // Skip over the seed that would make the Deck use the clock
+    unsigned gameSeed = seed + i;
+    if (gameSeed == Deck::DEFAULT_SEED) gameSeed = seed + config.games;
+    if (config.batch) {
+      batchSeeds.push_back(gameSeed);
+      if (batchSeeds.size() < BatchSimulator::BATCH_GAMES &&
+          i + 1 < config.games) continue;
+      for (const GameResult &result : batch->play(batchSeeds)) {
+        stats.add(result);
+      }
+      batchSeeds.clear();
+    } else if (config.core) {
+      stats.add(playCoreGame(config.players, gameSeed, config.shuffle));
+    } else {
+      game->play(gameSeed, result);
+      stats.add(result);
+    }
+  }
+  if (writer) writer->close();
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  out << "seed: " << seed << std::endl;
+  out << "players: " << config.players << std::endl;
+  stats.print(out, elapsed.count());
+  if (game) {
+    out << "memory/game: " << game->getMemory() << " bytes" << std::endl;
+    StrategyStats strategyStats;
+    game->addStrategyStats(strategyStats);
+    strategyStats.print(out);
+  }
+  if (countAllocations) allocStats.print(out);
+  if (config.assertZeroAlloc && allocStats.maxTurnAllocations > 0) {
+    out << "error: computer turns allocated" << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,128 @@
+#ifndef _H_SIMULATION
+#define _H_SIMULATION
+
+/*
+Headless batch simulation of complete games between computer players.
+Games run through a NullView, so no terminal I/O is done while playing,
+and only the aggregate statistics are printed at the end.
+
+A run plays all of its games on one HeadlessGame, which resets its model,
+players and strategies in place for each new seed instead of making them
+again. After the first game the allocator isn't touched at all, and the
+memory each game takes up is reported.
+*/
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+
+#include "deck.h"
+#include "controller.h"
+#include "model.h"
+#include "view.h"
+
+class GameRecorder;
+struct AllocStats;
+
+struct SimulationConfig {
+  // Number of complete games to play
+  unsigned games = 1;
+  // One character per seat. Only computer players ('c', 'm', 'e' or 't')
+  // may be used.
+  std::string players = "cccc";
+  // Game i is played with seed + i. If the seed is Deck::DEFAULT_SEED,
+  // a seed is picked from the current time.
+  unsigned seed = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  StrategyOptions strategies;
+  // If not empty, every game is written to this record file
+  std::string recordPath;
+  // Print the allocations made per computer turn, round and game
+  bool allocReport = false;
+  // Fail the run if any computer turn allocates
+  bool assertZeroAlloc = false;
+  // Play on the compile-time SimCore instead of the MVC classes.
+  // Only "cccc" is supported, and games can't be recorded or counted.
+  bool core = false;
+  // Play many games at once on the lockstep BatchSimulator, with the
+  // same restrictions as core
+  bool batch = false;
+};
+
+// The outcome of one finished game
+struct GameResult {
+  std::vector<int> scores;
+  std::vector<bool> won;
+  unsigned rounds = 0;
+};
+
+// A table of computer players that plays one complete game after another
+class HeadlessGame {
+  // Taken before the other members are made, to measure what they hold
+  const int64_t heapBefore;
+  StraightsModel model;
+  NullView view;
+  StraightsController controller;
+  size_t memory = 0;
+public:
+  // Throws InvalidPlayerType if players contains anything but computers
+  HeadlessGame(const std::string &players,
+               ShuffleMode shuffle = ShuffleMode::LEGACY,
+               const StrategyOptions &strategies = StrategyOptions{});
+  // Plays a complete game dealt from seed into result, reusing the
+  // result's vectors
+  void play(unsigned seed, GameResult &result);
+  // The game is given to the recorder from now on; nullptr stops it
+  void setRecorder(GameRecorder *recorder);
+  // Allocations are counted into stats from now on; nullptr stops it
+  void setAllocStats(AllocStats *stats);
+  // Bytes the game takes up, itself and on the heap, as measured over
+  // the first game played. 0 until then.
+  size_t getMemory() const;
+  // Adds what the players' strategies did over every game played to stats
+  void addStrategyStats(StrategyStats &stats);
+};
+
+// Accumulates results over many games
+class SimulationStats {
+  // Width of each score bucket in the distribution
+  static const int BUCKET_WIDTH;
+  unsigned long long games = 0;
+  unsigned long long rounds = 0;
+  std::vector<long> scoreSums;
+  std::vector<int> minScores;
+  std::vector<int> maxScores;
+  std::vector<unsigned long long> wins;
+  std::vector<unsigned long long> ties;
+  // scoreBuckets[seat][bucket] counts the final scores in that bucket
+  std::vector<std::vector<unsigned long long>> scoreBuckets;
+public:
+  void add(const GameResult &result);
+  // Adds the results of another set of games to this one
+  void merge(const SimulationStats &other);
+  unsigned long long getGames() const;
+  // Prints the aggregate results, along with the throughput of
+  // playing them in the given amount of seconds
+  void print(std::ostream &out, double seconds) const;
+};
+
+// Plays one complete game without any I/O and returns its result, on a
+// HeadlessGame made just for it.
+// Throws InvalidPlayerType if players contains anything but computers.
+// The game is given to the recorder, and its allocations counted into
+// allocStats, if there are any.
+GameResult playHeadlessGame(const std::string &players, unsigned seed,
+                            ShuffleMode shuffle = ShuffleMode::LEGACY,
+                            const StrategyOptions &strategies = StrategyOptions{},
+                            GameRecorder *recorder = nullptr,
+                            AllocStats *allocStats = nullptr);
+
+// Throws InvalidPlayerType unless every seat is a computer player
+void checkHeadlessPlayers(const std::string &players);
+
+// Plays config.games games, and prints the statistics to out.
+// Returns false if config.assertZeroAlloc is set and a turn allocated.
+bool runSimulation(const SimulationConfig &config, std::ostream &out);
+
+#endif
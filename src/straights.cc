@@ -6,20 +6,336 @@
 #include "model.h"
 #include "deck.h"
 #include "controller.h"
+#include "simulation.h"
+#include "tournament.h"
+#include "match.h"
+#include "scan.h"
+#include "perft.h"
+#include "server.h"
+#include "loadclient.h"
+#include "gamerecord.h"
+#include "trace.h"
 #include "debug.h"
 
 using namespace std;
 
+const string USAGE =
+  "Usage: straights [seed]\n"
+  "       straights --simulate N [--players cccc] [--seed S] [--shuffle MODE]\n"
+  "                 [--alloc-report] [--assert-zero-alloc]\n"
+  "       straights --tournament N [--players cccc] [--seed S] [--threads T]\n"
+  "                 [--shuffle MODE]\n"
+  "       straights --match XY [--seed S] [--shuffle MODE] [--match-deals N]\n"
+  "                 [--match-delta D]\n"
+  "       straights --serve ADDR [--serve ADDR] [--players hccc] [--seed S]\n"
+  "                 [--server-tables N] [--threads T]\n"
+  "       straights --load ADDR [--connections N]\n"
+  "       straights --replay FILE [--game G] [--round R] [--turn T]\n"
+  "       straights --scan PREDICATE [--seed S] [--scan-seeds N]\n"
+  "                 [--scan-matches M] [--threads T] [--shuffle MODE]\n"
+  "       straights --perft DEPTH [--seed S] [--shuffle MODE] [--threads T]\n"
+  "                 [--round R] [--perft-verify]\n"
+  "       straights --perft-check [--threads T]\n"
+  "Games can be recorded with --record FILE (not with --tournament).\n"
+  "Either mode can run on the compile-time core with --core, or many games\n"
+  "  at once in lockstep with --batch (cccc only).\n"
+  "Addresses: tcp:PORT, tcp:HOST:PORT or unix:PATH\n"
+  "Shuffle modes: legacy (default), xoshiro, pcg, counter\n"
+  "Computer players: c (simple), m (Monte Carlo tree search), tuned with\n"
+  "  [--mcts-iterations N] [--mcts-ms MS] [--mcts-threads T] [--mcts-ponder],\n"
+  "  e (simple, solving the end of each round exactly), tuned with\n"
+  "  [--endgame-cards N] [--endgame-table-bits B], and t (table-driven\n"
+  "  heuristic)\n"
+  "Any game can be traced with [--trace FILE] (Chrome trace_event JSON)\n"
+  "  and [--trace-report] (latency histograms).\n";
+
+// Prints and writes out whatever tracing was asked for.
+// Returns false if the trace file couldn't be written.
+bool finishTrace(const std::string &tracePath, const bool traceReport) {
+  if (!Trace::enabled()) return true;
+  Trace::disable();
+  if (traceReport) Trace::report(cout);
+  if (tracePath.empty()) return true;
+  try {
+    Trace::writeChrome(tracePath);
+  } catch (TraceIOError &e) {
+    cerr << "Error: " << e.what() << endl;
+    return false;
+  }
+  return true;
+}
+
 int main(int argc, char* argv[]) {
   Debug::print("Debug enabled");
   unsigned seed = Deck::DEFAULT_SEED;
-  if (argc == 2) {
-    Debug::print("Setting seed");
-    seed = std::stoi(std::string{argv[1]});
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  StrategyOptions strategies;
+  bool simulate = false;
+  bool tournament = false;
+  bool match = false;
+  MatchConfig matchConfig;
+  bool serve = false;
+  ServerConfig serverConfig;
+  bool load = false;
+  LoadConfig loadConfig;
+  SimulationConfig config;
+  TournamentConfig tournamentConfig;
+  std::string recordPath;
+  std::string tracePath;
+  bool traceReport = false;
+  bool replay = false;
+  ReplayConfig replayConfig;
+  bool scan = false;
+  ScanConfig scanConfig;
+  bool perft = false;
+  bool perftCheck = false;
+  PerftConfig perftConfig;
+  try {
+    for (int i = 1; i < argc; i++) {
+      const string arg{argv[i]};
+      const bool hasValue = i + 1 < argc;
+      if (arg == "--simulate" && hasValue) {
+        simulate = true;
+        config.games = std::stoul(argv[++i]);
+      } else if (arg == "--tournament" && hasValue) {
+        tournament = true;
+        tournamentConfig.games = std::stoull(argv[++i]);
+      } else if (arg == "--match" && hasValue) {
+        match = true;
+        const string types{argv[++i]};
+        if (types.size() != 2) throw std::invalid_argument{"match"};
+        matchConfig.first = types[0];
+        matchConfig.second = types[1];
+      } else if (arg == "--match-deals" && hasValue) {
+        matchConfig.maxDeals = std::stoull(argv[++i]);
+      } else if (arg == "--match-delta" && hasValue) {
+        matchConfig.delta = std::stod(argv[++i]);
+        if (matchConfig.delta <= 0) throw std::out_of_range{"delta"};
+      } else if (arg == "--scan" && hasValue) {
+        scan = true;
+        scanConfig.predicate = argv[++i];
+      } else if (arg == "--scan-seeds" && hasValue) {
+        scanConfig.seeds = std::stoull(argv[++i]);
+      } else if (arg == "--scan-matches" && hasValue) {
+        scanConfig.matches = std::stoull(argv[++i]);
+      } else if (arg == "--perft" && hasValue) {
+        perft = true;
+        perftConfig.depth = std::stoi(argv[++i]);
+        if (perftConfig.depth < 0 || perftConfig.depth > NUM_CARDS) {
+          throw std::out_of_range{"depth"};
+        }
+      } else if (arg == "--perft-verify") {
+        perftConfig.verify = true;
+      } else if (arg == "--perft-check") {
+        perftCheck = true;
+      } else if (arg == "--serve" && hasValue) {
+        serve = true;
+        NetAddress address;
+        if (!parseNetAddress(argv[++i], address)) {
+          throw std::invalid_argument{"address"};
+        }
+        serverConfig.addresses.push_back(address);
+      } else if (arg == "--server-tables" && hasValue) {
+        serverConfig.tables = std::stoull(argv[++i]);
+      } else if (arg == "--load" && hasValue) {
+        load = true;
+        if (!parseNetAddress(argv[++i], loadConfig.address)) {
+          throw std::invalid_argument{"address"};
+        }
+      } else if (arg == "--connections" && hasValue) {
+        loadConfig.connections = std::stoul(argv[++i]);
+      } else if (arg == "--core") {
+        config.core = true;
+        tournamentConfig.core = true;
+      } else if (arg == "--batch") {
+        config.batch = true;
+        tournamentConfig.batch = true;
+      } else if (arg == "--alloc-report") {
+        config.allocReport = true;
+      } else if (arg == "--assert-zero-alloc") {
+        config.assertZeroAlloc = true;
+      } else if (arg == "--threads" && hasValue) {
+        tournamentConfig.threads = std::stoul(argv[++i]);
+        serverConfig.threads = tournamentConfig.threads;
+        scanConfig.threads = tournamentConfig.threads;
+        perftConfig.threads = tournamentConfig.threads;
+      } else if (arg == "--players" && hasValue) {
+        config.players = argv[++i];
+        tournamentConfig.players = config.players;
+        serverConfig.players = config.players;
+      } else if (arg == "--seed" && hasValue) {
+        seed = std::stoul(argv[++i]);
+      } else if (arg == "--mcts-iterations" && hasValue) {
+        strategies.mcts.iterations = std::stoul(argv[++i]);
+      } else if (arg == "--mcts-ms" && hasValue) {
+        strategies.mcts.milliseconds = std::stoul(argv[++i]);
+      } else if (arg == "--mcts-threads" && hasValue) {
+        strategies.mcts.threads = std::stoul(argv[++i]);
+      } else if (arg == "--mcts-ponder") {
+        strategies.mcts.ponder = true;
+      } else if (arg == "--endgame-cards" && hasValue) {
+        strategies.endgame.cards = std::stoul(argv[++i]);
+      } else if (arg == "--endgame-table-bits" && hasValue) {
+        strategies.endgame.tableBits = std::stoul(argv[++i]);
+        if (strategies.endgame.tableBits > 30) throw std::out_of_range{"bits"};
+      } else if (arg == "--record" && hasValue) {
+        recordPath = argv[++i];
+      } else if (arg == "--trace" && hasValue) {
+        tracePath = argv[++i];
+      } else if (arg == "--trace-report") {
+        traceReport = true;
+      } else if (arg == "--replay" && hasValue) {
+        replay = true;
+        replayConfig.path = argv[++i];
+      } else if (arg == "--game" && hasValue) {
+        replayConfig.game = std::stoul(argv[++i]);
+      } else if (arg == "--round" && hasValue) {
+        // Rounds are numbered from 1 on the command line
+        replayConfig.round = std::stoi(argv[++i]) - 1;
+        if (replayConfig.round < 0) throw std::out_of_range{"round"};
+        perftConfig.round = replayConfig.round;
+      } else if (arg == "--turn" && hasValue) {
+        replayConfig.turn = std::stoul(argv[++i]);
+      } else if (arg == "--shuffle" && hasValue &&
+                 parseShuffleMode(argv[i + 1], shuffle)) {
+        i++;
+      } else if (arg.compare(0, 2, "--") != 0) {
+        Debug::print("Setting seed");
+        seed = std::stoul(arg);
+      } else {
+        cerr << USAGE;
+        return 1;
+      }
+    }
+  } catch (std::logic_error &e) {
+    cerr << USAGE;
+    return 1;
+  }
+  if (replay) {
+    try {
+      runReplay(replayConfig, cout);
+    } catch (RecordIOError &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    } catch (InvalidRecord &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    } catch (PositionNotInRecord &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if (scan) {
+    // Without --seed, scans from the first seed a Deck keeps
+    if (seed != Deck::DEFAULT_SEED) scanConfig.seed = seed;
+    scanConfig.shuffle = shuffle;
+    try {
+      runScan(scanConfig, cout);
+    } catch (InvalidPredicate &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if (perftCheck) {
+    return checkPerftReference(perftConfig.threads, cout) ? 0 : 1;
+  }
+  if (perft) {
+    perftConfig.seed = seed;
+    perftConfig.shuffle = shuffle;
+    return runPerft(perftConfig, cout) ? 0 : 1;
+  }
+  const bool fixedSeats = config.core || config.batch;
+  if (fixedSeats && (!recordPath.empty() || config.allocReport ||
+                     config.assertZeroAlloc)) {
+    cerr << USAGE;
+    return 1;
+  }
+  if (fixedSeats && config.players != "cccc") {
+    cerr << "Error: --core and --batch only support simple computer players "
+            "(cccc)." << endl;
+    return 1;
+  }
+  if (tournament && !recordPath.empty()) {
+    cerr << USAGE;
+    return 1;
+  }
+  if (!tracePath.empty() || traceReport) Trace::enable(!tracePath.empty());
+  if (serve) {
+    serverConfig.seed = seed;
+    serverConfig.shuffle = shuffle;
+    serverConfig.strategies = strategies;
+    try {
+      runServer(serverConfig, cout);
+    } catch (SocketError &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    } catch (InvalidPlayerType &e) {
+      cerr << "Error: Tables need at least one human seat (h), and computer "
+              "players (c, m, e, t) in the rest." << endl;
+      return 1;
+    }
+    return finishTrace(tracePath, traceReport) ? 0 : 1;
+  }
+  if (load) {
+    try {
+      return runLoadClient(loadConfig, cout) ? 0 : 1;
+    } catch (SocketError &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    }
+  }
+  if (match) {
+    matchConfig.seed = seed;
+    matchConfig.shuffle = shuffle;
+    matchConfig.strategies = strategies;
+    try {
+      runMatch(matchConfig, cout);
+    } catch (InvalidPlayerType &e) {
+      cerr << "Error: Matches may only be between computer players (c, m, e, t)."
+           << endl;
+      return 1;
+    }
+    return finishTrace(tracePath, traceReport) ? 0 : 1;
+  }
+  if (simulate || tournament) {
+    config.seed = seed;
+    config.recordPath = recordPath;
+    config.shuffle = shuffle;
+    config.strategies = strategies;
+    tournamentConfig.seed = seed;
+    tournamentConfig.shuffle = shuffle;
+    tournamentConfig.strategies = strategies;
+    try {
+      if (tournament) runTournament(tournamentConfig, cout);
+      else if (!runSimulation(config, cout)) return 1;
+    } catch (InvalidPlayerType &e) {
+      cerr << "Error: Simulated games may only have computer players (c, m, e, t)."
+           << endl;
+      return 1;
+    } catch (RecordIOError &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    }
+    return finishTrace(tracePath, traceReport) ? 0 : 1;
   }
   // If the seed is DEFAULT_SEED, it uses a default seed
-  StraightsModel model{seed};
+  StraightsModel model{seed, shuffle};
   TextView view;
-  StraightsController controller{view, model};
+  StraightsController controller{view, model, strategies};
+  std::unique_ptr<RecordWriter> writer;
+  std::unique_ptr<GameRecorder> recorder;
+  if (!recordPath.empty()) {
+    try {
+      writer = std::make_unique<RecordWriter>(recordPath);
+    } catch (RecordIOError &e) {
+      cerr << "Error: " << e.what() << endl;
+      return 1;
+    }
+    recorder = std::make_unique<GameRecorder>(*writer);
+    controller.setRecorder(recorder.get());
+  }
   controller.startGameLoop();
+  return finishTrace(tracePath, traceReport) ? 0 : 1;
 }
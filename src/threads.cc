@@ -0,0 +1,9 @@
+#include <algorithm>
+#include <thread>
+
+#include "threads.h"
+
+unsigned resolveThreads(const unsigned requested) {
+  if (requested > 0) return requested;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
@@ -0,0 +1,12 @@
+#ifndef _H_THREADS
+#define _H_THREADS
+
+/*
+Helpers shared by everything that splits its work over a pool of threads
+*/
+
+// The number of threads to run for a requested count; 0 means one per
+// hardware core, and the result is at least 1
+unsigned resolveThreads(unsigned requested);
+
+#endif
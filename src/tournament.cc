@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "tournament.h"
+#include "simulation.h"
+#include "simcore.h"
+#include "batchsim.h"
+#include "controller.h"
+#include "deck.h"
+#include "debug.h"
+#include "threads.h"
+
+unsigned deriveGameSeed(const uint64_t masterSeed, const uint64_t gameIndex) {
+  // SplitMix64 finalizer over the master seed and index, so neighbouring
+  // games get unrelated seeds
+  uint64_t z = masterSeed * 0x9E3779B97F4A7C15ULL + gameIndex + 1;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z ^= z >> 31;
+  unsigned seed = static_cast<unsigned>(z);
+  if (seed == Deck::DEFAULT_SEED) seed = static_cast<unsigned>(z >> 32) | 1;
+  return seed;
+}
+
+void runTournament(const TournamentConfig &config, std::ostream &out) {
+  checkHeadlessPlayers(config.players);
+  unsigned seed = config.seed;
+  if (seed == Deck::DEFAULT_SEED) {
+    seed = std::chrono::system_clock::now().time_since_epoch().count();
+  }
+  const unsigned threads = resolveThreads(config.threads);
+  Debug::print("Tournament seed: " + std::to_string(seed));
+
+  // Workers claim games by index, and keep their own stats.
+  // Merging only sums and compares, so the order doesn't matter.
+  std::atomic<uint64_t> nextGame{0};
+  std::vector<SimulationStats> workerStats(threads);
+  // Bytes taken up by each worker's game, if it played one
+  std::vector<size_t> workerMemory(threads, 0);
+  std::vector<StrategyStats> workerStrategyStats(threads);
+  auto worker = [&config, &nextGame, seed](SimulationStats &stats,
+                                           size_t &memory,
+                                           StrategyStats &strategyStats) {
+    if (config.batch) {
+      // Claims a batch of games at a time
+      BatchSimulator batch{config.shuffle};
+      std::vector<unsigned> seeds;
+      while (true) {
+        const uint64_t first = nextGame.fetch_add(BatchSimulator::BATCH_GAMES);
+        if (first >= config.games) return;
+        seeds.clear();
+        for (uint64_t game = first; game < config.games &&
+             game < first + BatchSimulator::BATCH_GAMES; game++) {
+          seeds.push_back(deriveGameSeed(seed, game));
+        }
+        for (const GameResult &result : batch.play(seeds)) stats.add(result);
+      }
+    }
+    if (config.core) {
+      while (true) {
+        const uint64_t game = nextGame.fetch_add(1);
+        if (game >= config.games) return;
+        stats.add(playCoreGame(config.players, deriveGameSeed(seed, game),
+                               config.shuffle));
+      }
+    }
+    HeadlessGame table{config.players, config.shuffle, config.strategies};
+    GameResult result;
+    while (true) {
+      const uint64_t game = nextGame.fetch_add(1);
+      if (game >= config.games) break;
+      table.play(deriveGameSeed(seed, game), result);
+      stats.add(result);
+    }
+    memory = table.getMemory();
+    table.addStrategyStats(strategyStats);
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; i++) {
+    pool.emplace_back(worker, std::ref(workerStats[i]),
+                      std::ref(workerMemory[i]), std::ref(workerStrategyStats[i]));
+  }
+  worker(workerStats[0], workerMemory[0], workerStrategyStats[0]);
+  for (auto &t : pool) {
+    t.join();
+  }
+  SimulationStats stats;
+  for (auto &s : workerStats) {
+    stats.merge(s);
+  }
+  StrategyStats strategyStats;
+  for (const auto &s : workerStrategyStats) {
+    strategyStats.merge(s);
+  }
+  const std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  out << "seed: " << seed << std::endl;
+  out << "players: " << config.players << std::endl;
+  out << "threads: " << threads << std::endl;
+  stats.print(out, elapsed.count());
+  if (!config.core && !config.batch) {
+    out << "memory/game: "
+        << *std::max_element(workerMemory.begin(), workerMemory.end())
+        << " bytes" << std::endl;
+    strategyStats.print(out);
+  }
+}
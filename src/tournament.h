@@ -0,0 +1,44 @@
+#ifndef _H_TOURNAMENT
+#define _H_TOURNAMENT
+
+/*
+Runs a large number of headless games across several threads.
+
+Every game's seed is derived from the master seed and the game's index
+alone, and each worker plays its games on its own HeadlessGame, reset in
+place between games, so the results are identical whatever the number of
+threads. The memory each concurrent game takes up is reported.
+*/
+
+#include <string>
+#include <iostream>
+#include <cstdint>
+
+#include "deck.h"
+#include "controller.h"
+
+struct TournamentConfig {
+  uint64_t games = 1;
+  // One character per seat. Only computer players ('c', 'm', 'e' or 't')
+  // may be used.
+  std::string players = "cccc";
+  // If the seed is Deck::DEFAULT_SEED, a seed is picked from the current time.
+  unsigned seed = 0;
+  // 0 uses one thread per hardware core
+  unsigned threads = 0;
+  ShuffleMode shuffle = ShuffleMode::LEGACY;
+  StrategyOptions strategies;
+  // Play on the compile-time SimCore; only "cccc" is supported
+  bool core = false;
+  // Play on a lockstep BatchSimulator per thread; only "cccc" is supported
+  bool batch = false;
+};
+
+// The Deck seed used for the gameIndex'th game of a tournament.
+// Never returns Deck::DEFAULT_SEED, so games never fall back to the clock.
+unsigned deriveGameSeed(uint64_t masterSeed, uint64_t gameIndex);
+
+// Plays config.games games, and prints the statistics to out
+void runTournament(const TournamentConfig &config, std::ostream &out);
+
+#endif
@@ -0,0 +1,240 @@
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "trace.h"
+
+namespace {
+  const int NUM_SPANS = static_cast<int>(TraceSpan::COUNT);
+  const int NUM_COUNTERS = static_cast<int>(TraceCounter::COUNT);
+  // Each power of two is split into this many histogram buckets
+  const int SUB_BUCKET_BITS = 2;
+  const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  const int NUM_BUCKETS = SUB_BUCKETS * (64 - SUB_BUCKET_BITS + 1);
+  // Events kept per thread for the Chrome trace; later ones are dropped
+  const size_t MAX_EVENTS = 1 << 20;
+
+  struct Event {
+    TraceSpan span;
+    uint64_t start;
+    uint64_t duration;
+  };
+
+  // What one thread has recorded
+  struct ThreadTrace {
+    int tid;
+    uint64_t counters[NUM_COUNTERS] = {};
+    uint64_t buckets[NUM_SPANS][NUM_BUCKETS] = {};
+    uint64_t totals[NUM_SPANS] = {};
+    uint64_t maxima[NUM_SPANS] = {};
+    std::vector<Event> events;
+    uint64_t dropped = 0;
+    explicit ThreadTrace(int tid) : tid{tid} {}
+    void clear() {
+      *this = ThreadTrace{tid};
+    }
+  };
+
+  // Every thread that ever recorded, kept after the threads exit
+  std::mutex threadsMutex;
+  std::vector<std::unique_ptr<ThreadTrace>> threads;
+  thread_local ThreadTrace *local = nullptr;
+  std::chrono::steady_clock::time_point epoch;
+  bool keepEvents = false;
+
+  ThreadTrace &localTrace() {
+    if (!local) {
+      std::lock_guard<std::mutex> lock{threadsMutex};
+      threads.push_back(std::make_unique<ThreadTrace>(threads.size()));
+      local = threads.back().get();
+    }
+    return *local;
+  }
+
+  int bucketOf(const uint64_t ns) {
+    if (ns < SUB_BUCKETS) return ns;
+    int exponent = 63 - __builtin_clzll(ns);
+    const int sub = (ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS * (exponent - SUB_BUCKET_BITS + 1) + sub;
+  }
+
+  // Smallest duration that falls in the bucket
+  uint64_t bucketFloor(const int bucket) {
+    if (bucket < SUB_BUCKETS) return bucket;
+    if (bucket >= NUM_BUCKETS) return UINT64_MAX;
+    const int exponent = bucket / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const uint64_t sub = bucket % SUB_BUCKETS;
+    return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+  }
+
+  std::string formatDuration(const double ns) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    if (ns < 1e3) out << ns << "ns";
+    else if (ns < 1e6) out << ns / 1e3 << "us";
+    else if (ns < 1e9) out << ns / 1e6 << "ms";
+    else out << ns / 1e9 << "s";
+    return out.str();
+  }
+}
+
+std::atomic<bool> Trace::on{false};
+
+const char *traceSpanName(const TraceSpan span) {
+  switch (span) {
+    case TraceSpan::GAME: return "game";
+    case TraceSpan::ROUND: return "round";
+    case TraceSpan::SHUFFLE: return "shuffle";
+    case TraceSpan::DEAL: return "deal";
+    case TraceSpan::TURN: return "turn";
+    case TraceSpan::DECISION: return "decision";
+    default: return "unknown";
+  }
+}
+
+const char *traceCounterName(const TraceCounter counter) {
+  switch (counter) {
+    case TraceCounter::PLAYS: return "plays";
+    case TraceCounter::DISCARDS: return "discards";
+    case TraceCounter::MCTS_ITERATIONS: return "mcts_iterations";
+    case TraceCounter::ENDGAME_NODES: return "endgame_nodes";
+    default: return "unknown";
+  }
+}
+
+void Trace::enable(const bool events) {
+  {
+    std::lock_guard<std::mutex> lock{threadsMutex};
+    for (auto &t : threads) t->clear();
+    keepEvents = events;
+    epoch = std::chrono::steady_clock::now();
+  }
+  on = true;
+}
+
+void Trace::disable() {
+  on = false;
+}
+
+void Trace::addSlow(const TraceCounter counter, const uint64_t amount) {
+  localTrace().counters[static_cast<int>(counter)] += amount;
+}
+
+void Trace::record(const TraceSpan span,
+                   const std::chrono::steady_clock::time_point start) {
+  const auto end = std::chrono::steady_clock::now();
+  const uint64_t duration =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  ThreadTrace &t = localTrace();
+  const int s = static_cast<int>(span);
+  t.buckets[s][bucketOf(duration)]++;
+  t.totals[s] += duration;
+  if (duration > t.maxima[s]) t.maxima[s] = duration;
+  if (!keepEvents) return;
+  if (t.events.size() >= MAX_EVENTS) {
+    t.dropped++;
+    return;
+  }
+  const uint64_t offset =
+    std::chrono::duration_cast<std::chrono::nanoseconds>(start - epoch).count();
+  t.events.push_back(Event{span, offset, duration});
+}
+
+void Trace::report(std::ostream &out) {
+  std::lock_guard<std::mutex> lock{threadsMutex};
+  for (int c = 0; c < NUM_COUNTERS; c++) {
+    uint64_t total = 0;
+    for (auto &t : threads) total += t->counters[c];
+    out << "trace " << traceCounterName(static_cast<TraceCounter>(c))
+        << ": " << total << std::endl;
+  }
+  for (int s = 0; s < NUM_SPANS; s++) {
+    std::vector<uint64_t> buckets(NUM_BUCKETS, 0);
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+    for (auto &t : threads) {
+      for (int b = 0; b < NUM_BUCKETS; b++) {
+        buckets[b] += t->buckets[s][b];
+        count += t->buckets[s][b];
+      }
+      total += t->totals[s];
+      if (t->maxima[s] > max) max = t->maxima[s];
+    }
+    if (count == 0) continue;
+    // Percentiles are reported as the floor of their bucket
+    auto percentile = [&buckets, count](double p) {
+      const uint64_t rank = static_cast<uint64_t>(p * (count - 1));
+      uint64_t seen = 0;
+      for (int b = 0; b < NUM_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen > rank) return bucketFloor(b);
+      }
+      return bucketFloor(NUM_BUCKETS - 1);
+    };
+    out << "trace " << traceSpanName(static_cast<TraceSpan>(s))
+        << ": count " << count
+        << " mean " << formatDuration(static_cast<double>(total) / count)
+        << " p50 " << formatDuration(percentile(0.5))
+        << " p90 " << formatDuration(percentile(0.9))
+        << " p99 " << formatDuration(percentile(0.99))
+        << " max " << formatDuration(max) << std::endl;
+    // One bucket per power of two
+    out << "  distribution:";
+    for (int b = 0; b < NUM_BUCKETS; b += SUB_BUCKETS) {
+      uint64_t n = 0;
+      for (int i = b; i < b + SUB_BUCKETS; i++) n += buckets[i];
+      if (n == 0) continue;
+      out << " [" << formatDuration(bucketFloor(b)) << ","
+          << formatDuration(bucketFloor(b + SUB_BUCKETS)) << "):" << n;
+    }
+    out << std::endl;
+  }
+  uint64_t dropped = 0;
+  for (auto &t : threads) dropped += t->dropped;
+  if (dropped > 0) {
+    out << "trace events dropped: " << dropped << std::endl;
+  }
+}
+
+void Trace::writeChrome(const std::string &path) {
+  std::ofstream out{path};
+  if (!out) throw TraceIOError{};
+  std::lock_guard<std::mutex> lock{threadsMutex};
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  auto separate = [&out, &first]() {
+    out << (first ? "\n" : ",\n");
+    first = false;
+  };
+  uint64_t end = 0;
+  for (auto &t : threads) {
+    separate();
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t->tid
+        << ",\"args\":{\"name\":\"thread " << t->tid << "\"}}";
+    // Timestamps are in microseconds
+    for (const Event &e : t->events) {
+      separate();
+      out << "{\"name\":\"" << traceSpanName(e.span)
+          << "\",\"cat\":\"straights\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t->tid
+          << ",\"ts\":" << e.start / 1e3 << ",\"dur\":" << e.duration / 1e3
+          << "}";
+      if (e.start + e.duration > end) end = e.start + e.duration;
+    }
+  }
+  // The counters' totals, at the end of the trace
+  for (int c = 0; c < NUM_COUNTERS; c++) {
+    uint64_t total = 0;
+    for (auto &t : threads) total += t->counters[c];
+    separate();
+    out << "{\"name\":\"" << traceCounterName(static_cast<TraceCounter>(c))
+        << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << end / 1e3
+        << ",\"args\":{\"value\":" << total << "}}";
+  }
+  out << "\n]}\n";
+  if (!out) throw TraceIOError{};
+}
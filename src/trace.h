@@ -0,0 +1,101 @@
+#ifndef _H_TRACE
+#define _H_TRACE
+
+/*
+Instrumentation that can be switched on at runtime, in any build.
+
+Scoped timers (TraceScope) measure turns, strategy decisions, shuffles,
+deals, rounds and games, and Trace::add bumps counters. While tracing is
+off, each of these is a single relaxed load and a branch.
+
+While it's on, every thread keeps its own latency histograms and counters,
+and optionally a list of events for a Chrome trace_event JSON file (open
+it in chrome://tracing or Perfetto). Threads never share anything while
+recording, so tracing tournaments doesn't add contention.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Timed sections
+enum class TraceSpan {
+  GAME, ROUND, SHUFFLE, DEAL, TURN, DECISION, COUNT
+};
+
+// Counted events
+enum class TraceCounter {
+  PLAYS, DISCARDS, MCTS_ITERATIONS, ENDGAME_NODES, COUNT
+};
+
+const char *traceSpanName(TraceSpan span);
+const char *traceCounterName(TraceCounter counter);
+
+class Trace {
+  // Is a static class
+  Trace() {};
+  static std::atomic<bool> on;
+public:
+  // Starts recording. If events is set, every span is also kept for
+  // writeChrome, up to a limit per thread.
+  static void enable(bool events);
+  static void disable();
+  static bool enabled() {
+    return on.load(std::memory_order_relaxed);
+  }
+  static void add(TraceCounter counter, uint64_t amount = 1) {
+    if (enabled()) addSlow(counter, amount);
+  }
+  static void addSlow(TraceCounter counter, uint64_t amount);
+  // Records a span that started at start and ends now
+  static void record(TraceSpan span, std::chrono::steady_clock::time_point start);
+  // Prints the counters, and the latency percentiles and histogram of
+  // each span, summed over every thread
+  static void report(std::ostream &out);
+  // Writes the kept spans as Chrome trace_event JSON.
+  // Throws TraceIOError if the file can't be written.
+  static void writeChrome(const std::string &path);
+};
+
+// Times the enclosing scope as the given span
+class TraceScope {
+  const TraceSpan span;
+  const bool active;
+  std::chrono::steady_clock::time_point start;
+public:
+  explicit TraceScope(const TraceSpan span) :
+    span{span}, active{Trace::enabled()}
+  {
+    if (active) start = std::chrono::steady_clock::now();
+  }
+  ~TraceScope() {
+    if (active) Trace::record(span, start);
+  }
+  TraceScope(const TraceScope &) = delete;
+  TraceScope &operator=(const TraceScope &) = delete;
+};
+
+// Times a span that starts and ends in different calls
+class TraceTimer {
+  const TraceSpan span;
+  bool active = false;
+  std::chrono::steady_clock::time_point start;
+public:
+  explicit TraceTimer(const TraceSpan span) : span{span} {}
+  void begin() {
+    active = Trace::enabled();
+    if (active) start = std::chrono::steady_clock::now();
+  }
+  void end() {
+    if (active) Trace::record(span, start);
+    active = false;
+  }
+};
+
+struct TraceIOError {
+  const char *what() const { return "Could not write the trace file"; }
+};
+
+#endif
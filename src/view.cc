@@ -1,6 +1,11 @@
 #include "view.h"
 #include "deck.h"
 
+void View::beginTurn(const std::string &) {}
+
+TextView::TextView(std::ostream &out, std::istream &in) : out{out}, in{in}
+{}
+
 void TextView::displayBoard(const std::deque<Card*> &clubs,
   const std::deque<Card*> &diamonds, const std::deque<Card*> &hearts,
   const std::deque<Card*> &spades) 
@@ -32,11 +37,17 @@ void TextView::displayLegalPlays(const std::vector<Card*>& legalPlays) {
   out << std::endl;
 }
 
-void TextView::displayMessage(const std::string msg) {
+void TextView::displayMessage(const std::string &msg) {
   out << msg << std::endl;
 }
 
-void TextView::displayError(const std::string err) {
+void TextView::displayMove(const std::string &playerName, const Card &card,
+                           const bool discard) {
+  out << YELLOW << playerName << RESET << (discard ? " discards " : " plays ")
+      << card << std::endl;
+}
+
+void TextView::displayError(const std::string &err) {
   out << RED << BOLD << "Error: " << RESET;
   out << err << std::endl;
 }
@@ -48,8 +59,12 @@ std::string TextView::promptCardSelection(const std::string msg = "") {
   return card;
 }
 
-std::string TextView::promptCommand() {
+void TextView::displayCommandPrompt() {
   out << "> ";
+}
+
+std::string TextView::promptCommand() {
+  displayCommandPrompt();
   std::string command;
   in >> command;
   return command;
@@ -88,3 +103,31 @@ void TextView::printCardValues(const std::deque<Card*>& cards) {
   out << (*card)->getStringRep()[0];
 }
 
+
+void NullView::displayBoard(const std::deque<Card*>&, const std::deque<Card*>&,
+  const std::deque<Card*>&, const std::deque<Card*>&)
+{}
+
+void NullView::displayHand(const std::vector<Card*>&) {}
+
+void NullView::displayLegalPlays(const std::vector<Card*>&) {}
+
+void NullView::displayMessage(const std::string &) {}
+
+void NullView::displayError(const std::string &) {}
+
+void NullView::displayMove(const std::string &, const Card &, bool) {}
+
+std::string NullView::promptCardSelection(const std::string) {
+  return "";
+}
+
+std::string NullView::promptCommand() {
+  return "quit";
+}
+
+void NullView::displayScore(std::string, const std::vector<Card*>&,
+                            const int, const int)
+{}
+
+void NullView::displayWin(const std::string) {}
@@ -19,12 +19,19 @@ public:
                             const std::deque<Card*>& hearts, const std::deque<Card*>& spades) = 0;
   virtual void displayHand(const std::vector<Card*>& hand) = 0;
   virtual void displayLegalPlays(const std::vector<Card*>& legalPlays) = 0;
-  virtual void displayMessage(std::string msg) = 0;
-  virtual void displayError(std::string err) = 0;
+  virtual void displayMessage(const std::string &msg) = 0;
+  virtual void displayError(const std::string &err) = 0;
+  // Shows that a player played (or discarded) a card
+  virtual void displayMove(const std::string &playerName, const Card &card,
+                           bool discard) = 0;
   virtual std::string promptCardSelection(std::string msg = "") = 0;
   virtual std::string promptCommand() = 0;
   virtual void displayScore(std::string playerName, const std::vector<Card*>& discards, int oldScore, int newScore) = 0;
   virtual void displayWin(std::string playerName) = 0;
+  // Called when a human player's turn starts, before anything is shown
+  // to them. Views shared by several players use it to pick who to prompt.
+  virtual void beginTurn(const std::string &playerName);
+  virtual ~View() = default;
 };
 
 class TextView: public View{
@@ -33,12 +40,36 @@ class TextView: public View{
   void printCardList(const std::vector<Card*>& cards);
   void printCardValues(const std::deque<Card*>& cards);
 public:
+  TextView() = default;
+  TextView(std::ostream &out, std::istream &in);
   void displayBoard(const std::deque<Card*>& clubs, const std::deque<Card*>& diamonds,
                             const std::deque<Card*>& hearts, const std::deque<Card*>& spades) override;
   void displayHand(const std::vector<Card*>& hand) override;
   void displayLegalPlays(const std::vector<Card*>& legalPlays) override;
-  void displayMessage(std::string msg) override;
-  void displayError(std::string err) override;
+  void displayMessage(const std::string &msg) override;
+  void displayError(const std::string &err) override;
+  void displayMove(const std::string &playerName, const Card &card,
+                   bool discard) override;
+  std::string promptCardSelection(std::string msg) override;
+  std::string promptCommand() override;
+  void displayScore(std::string playerName, const std::vector<Card*>& discards, int oldScore, int newScore) override;
+  void displayWin(std::string playerName) override;
+  // Shows the prompt promptCommand reads after, without reading anything
+  void displayCommandPrompt();
+};
+
+// Discards all output. Used for headless games between computer players,
+// where nothing should be prompted; prompts answer "quit".
+class NullView: public View {
+public:
+  void displayBoard(const std::deque<Card*>& clubs, const std::deque<Card*>& diamonds,
+                            const std::deque<Card*>& hearts, const std::deque<Card*>& spades) override;
+  void displayHand(const std::vector<Card*>& hand) override;
+  void displayLegalPlays(const std::vector<Card*>& legalPlays) override;
+  void displayMessage(const std::string &msg) override;
+  void displayError(const std::string &err) override;
+  void displayMove(const std::string &playerName, const Card &card,
+                   bool discard) override;
   std::string promptCardSelection(std::string msg) override;
   std::string promptCommand() override;
   void displayScore(std::string playerName, const std::vector<Card*>& discards, int oldScore, int newScore) override;
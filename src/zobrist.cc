@@ -0,0 +1,4 @@
+#include "zobrist.h"
+
+// Constant initialized, so it's ready before any other static is made
+constexpr ZobristKeys ZOBRIST{};
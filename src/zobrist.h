@@ -0,0 +1,58 @@
+#ifndef _H_ZOBRIST
+#define _H_ZOBRIST
+
+/*
+Random keys for Zobrist hashing of positions. A position's hash is the xor
+of the keys of everything in it, so moving a card only takes an xor to
+remove its old key and another to add its new one.
+
+The keys are generated at compile time from a fixed seed, so hashes are
+the same on every run.
+*/
+
+#include <cstdint>
+
+#include "bitboard.h"
+#include "simstate.h"
+#include "rng.h"
+
+// Pile keys are indexed by low * PILE_KEY_STRIDE + high
+const int PILE_KEY_STRIDE = RANKS_PER_SUIT + 1;
+
+struct ZobristKeys {
+  // A card in a seat's hand
+  uint64_t hand[NUM_SEATS][NUM_CARDS];
+  // A card in a seat's discards
+  uint64_t discard[NUM_SEATS][NUM_CARDS];
+  // A pile's extent. Empty piles have a key of 0, so an empty board
+  // hashes to 0.
+  uint64_t pile[NUM_SUITS][PILE_KEY_STRIDE * PILE_KEY_STRIDE];
+  uint64_t toMove[NUM_SEATS];
+  // For searches whose results depend on which seat they're for
+  uint64_t root[NUM_SEATS];
+  constexpr ZobristKeys() : hand{}, discard{}, pile{}, toMove{}, root{} {
+    uint64_t seed = 0x5EED;
+    for (int seat = 0; seat < NUM_SEATS; seat++) {
+      for (int card = 0; card < NUM_CARDS; card++) {
+        hand[seat][card] = splitMix64(seed);
+        discard[seat][card] = splitMix64(seed);
+      }
+      toMove[seat] = splitMix64(seed);
+      root[seat] = splitMix64(seed);
+    }
+    for (int suit = 0; suit < NUM_SUITS; suit++) {
+      for (int i = 1; i < PILE_KEY_STRIDE * PILE_KEY_STRIDE; i++) {
+        pile[suit][i] = splitMix64(seed);
+      }
+    }
+  }
+};
+
+extern const ZobristKeys ZOBRIST;
+
+// Key of a suit's pile, indexed by suit - 1
+inline uint64_t pileKey(int suit, PileBounds pile) {
+  return ZOBRIST.pile[suit][pile.low * PILE_KEY_STRIDE + pile.high];
+}
+
+#endif